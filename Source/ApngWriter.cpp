@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// frm2png includes
+#include "ApngWriter.h"
+#include "PngEncoder.h"
+#include "PngImage.h"
+#include "PngPalette.h"
+#include "Sink.h"
+#include "ThreadPool.h"
+
+// Third party includes
+#include <png.h>
+
+namespace frm2png
+{
+    ApngWriter::ApngWriter( const std::string& filename, ThreadPool& pool, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette /* = nullptr */, SinkFactory* sinks /* = nullptr */ ) :
+        ApngWriter( CreateFileSink( sinks, filename ), nullptr, pool, candidates, palette )
+    {}
+
+    ApngWriter::ApngWriter( Sink& sink, ThreadPool& pool, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette /* = nullptr */ ) :
+        ApngWriter( nullptr, &sink, pool, candidates, palette )
+    {}
+
+    ApngWriter::ApngWriter( std::unique_ptr<Sink> ownSink, Sink* sink, ThreadPool& pool, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette ) :
+        _ownSink( std::move( ownSink ) ),
+        _sink( sink ? sink : _ownSink.get() ),
+        _pool( pool ),
+        _candidates( candidates )
+    {
+        if( _candidates.empty() )
+            throw std::runtime_error( "ApngWriter::ApngWriter() - No encoder settings" );
+
+        if( palette )
+            _palette = std::make_shared<const PngPalette>( *palette );
+    }
+
+    ApngWriter::~ApngWriter()
+    {
+        // make sure no task outlives writer, even if animation was not finished
+        // queued tasks are run while waiting, as all other workers might be destroying writers as well
+        for( auto& frame : _pending )
+        {
+            for( auto& data : frame.Data )
+            {
+                if( data.valid() )
+                    _pool.ready( data );
+            }
+        }
+    }
+
+    void ApngWriter::writeAnimHeader( uint32_t width, uint32_t height, uint32_t frames, uint32_t loop, bool preview )
+    {
+        if( !width || !height )
+            throw std::runtime_error( "ApngWriter::writeAnimHeader() - Invalid size" );
+        if( frames < ( preview ? 2u : 1u ) )
+            throw std::runtime_error( "ApngWriter::writeAnimHeader() - Invalid number of frames (" + std::to_string( frames ) + ")" );
+
+        // header is written together with first frame, when color type is known
+        _width   = width;
+        _height  = height;
+        _frames  = frames;
+        _loop    = loop;
+        _preview = preview;
+    }
+
+    void ApngWriter::writeAnimFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint16_t delayNum, uint16_t delayDen, uint8_t dispose, uint8_t blend )
+    {
+        const uint32_t frameIdx = _framesWritten + static_cast<uint32_t>( _pending.size() );
+
+        if( !_frames )
+            throw std::runtime_error( "ApngWriter::writeAnimFrame() - Header not written" );
+        if( frameIdx >= _frames )
+            throw std::runtime_error( "ApngWriter::writeAnimFrame() - Too many frames" );
+        if( !frameIdx && ( image.width() != _width || image.height() != _height || offsetX || offsetY ) )
+            throw std::runtime_error( "ApngWriter::writeAnimFrame() - First frame must match image size" );
+        if( offsetX + image.width() > _width || offsetY + image.height() > _height )
+            throw std::runtime_error( "ApngWriter::writeAnimFrame() - Frame outside of image" );
+
+        // caller is free to reuse image as soon as function returns
+        std::shared_ptr<PngImage> copy = std::make_shared<PngImage>( image, 0, 0, image.width(), image.height() );
+
+        Frame frame;
+        frame.Width    = image.width();
+        frame.Height   = image.height();
+        frame.OffsetX  = offsetX;
+        frame.OffsetY  = offsetY;
+        frame.DelayNum = delayNum;
+        frame.DelayDen = delayDen;
+        frame.Dispose  = dispose;
+        frame.Blend    = blend;
+
+        for( const auto& settings : _candidates )
+        {
+            frame.Data.push_back( _pool.submit( [copy, settings, palette = _palette]() { return PngCompress( *copy, settings, palette.get() ); } ) );
+        }
+
+        _pending.push_back( std::move( frame ) );
+
+        if( _candidates.size() == 1 )
+            writeFrames( false );
+    }
+
+    void ApngWriter::writeAnimEnd()
+    {
+        if( _candidates.size() == 1 )
+            writeFrames( true );
+        else
+            writeOptimized();
+
+        if( _framesWritten != _frames )
+            throw std::runtime_error( "ApngWriter::writeAnimEnd() - Invalid number of frames (" + std::to_string( _framesWritten ) + " != " + std::to_string( _frames ) + ")" );
+
+        // IEND chunk
+        PngWriteChunk( *_sink, "IEND", nullptr, 0 );
+
+        _sink->close();
+    }
+
+    const std::string& ApngWriter::summary() const
+    {
+        return _summary;
+    }
+
+    void ApngWriter::writeHeader( bool indexed )
+    {
+        PngWriteSignature( *_sink );
+
+        // IHDR chunk, PLTE/tRNS chunks
+        PngWriteHeader( *_sink, _width, _height, indexed ? _palette.get() : nullptr );
+
+        // acTL chunk; hidden preview image is not part of animation
+        std::vector<uint8_t> actl;
+        PngPut32( actl, _frames - ( _preview ? 1 : 0 ) );
+        PngPut32( actl, _loop );
+        PngWriteChunk( *_sink, "acTL", actl );
+    }
+
+    void ApngWriter::writeFrame( const Frame& frame, const std::vector<uint8_t>& data )
+    {
+        // fcTL chunk; not used by hidden preview image
+        if( _framesWritten || !_preview )
+        {
+            std::vector<uint8_t> fctl;
+            PngPut32( fctl, _sequence++ );
+            PngPut32( fctl, frame.Width );
+            PngPut32( fctl, frame.Height );
+            PngPut32( fctl, frame.OffsetX );
+            PngPut32( fctl, frame.OffsetY );
+            PngPut16( fctl, frame.DelayNum );
+            PngPut16( fctl, frame.DelayDen );
+            PngPut8( fctl, frame.Dispose );
+            PngPut8( fctl, frame.Blend );
+            PngWriteChunk( *_sink, "fcTL", fctl );
+        }
+
+        // IDAT chunk for first frame, fdAT chunk for others
+        if( !_framesWritten )
+            PngWriteChunk( *_sink, "IDAT", data );
+        else
+        {
+            std::vector<uint8_t> fdat;
+            fdat.reserve( data.size() + 4 );
+            PngPut32( fdat, _sequence++ );
+            fdat.insert( fdat.end(), data.begin(), data.end() );
+            PngWriteChunk( *_sink, "fdAT", fdat );
+        }
+
+        _framesWritten++;
+    }
+
+    void ApngWriter::writeFrames( bool wait )
+    {
+        while( !_pending.empty() )
+        {
+            Frame& frame = _pending.front();
+
+            if( !wait && frame.Data.front().wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+                break;
+
+            std::vector<uint8_t> data = _pool.wait( frame.Data.front() );
+            if( data.empty() )
+                throw std::runtime_error( "ApngWriter::writeFrames() - Frame cannot be encoded with given settings" );
+
+            if( !_framesWritten )
+            {
+                writeHeader( _candidates.front().Indexed );
+                _summary = PngEncoderSettingsToString( _candidates.front() );
+            }
+
+            writeFrame( frame, data );
+            _pending.pop_front();
+        }
+    }
+
+    void ApngWriter::writeOptimized()
+    {
+        for( auto& frame : _pending )
+        {
+            for( auto& data : frame.Data )
+                _pool.ready( data );
+        }
+
+        std::vector<std::vector<std::vector<uint8_t>>> results;
+        for( auto& frame : _pending )
+        {
+            results.emplace_back();
+
+            for( auto& data : frame.Data )
+                results.back().push_back( data.get() );
+        }
+
+        // find best candidate for each frame, separately for each color type
+        // best[T][F] = color type T (0 = rgba, 1 = indexed), frame F, candidate index
+        const std::size_t        none = _candidates.size();
+        std::vector<std::size_t> best[2];
+        std::size_t              total[2] = { 0, 0 };
+        bool                     valid[2] = { true, true };
+
+        for( uint8_t type = 0; type < 2; type++ )
+        {
+            for( const auto& frame : results )
+            {
+                std::size_t frameBest = none;
+
+                for( std::size_t idx = 0; idx < _candidates.size(); idx++ )
+                {
+                    if( _candidates[idx].Indexed != ( type == 1 ) || frame[idx].empty() )
+                        continue;
+
+                    if( frameBest == none || frame[idx].size() < frame[frameBest].size() )
+                        frameBest = idx;
+                }
+
+                if( frameBest == none )
+                {
+                    valid[type] = false;
+                    break;
+                }
+
+                best[type].push_back( frameBest );
+                total[type] += frame[frameBest].size();
+            }
+        }
+
+        if( !valid[0] && !valid[1] )
+            throw std::runtime_error( "ApngWriter::writeOptimized() - Animation cannot be encoded with given settings" );
+
+        const uint8_t type = !valid[0] || ( valid[1] && total[1] < total[0] ) ? 1 : 0;
+
+        writeHeader( type == 1 );
+
+        std::map<std::size_t, uint32_t> used;
+        for( std::size_t frameIdx = 0; frameIdx < results.size(); frameIdx++ )
+        {
+            const std::size_t candidate = best[type][frameIdx];
+
+            writeFrame( _pending[frameIdx], results[frameIdx][candidate] );
+            used[candidate]++;
+        }
+
+        _pending.clear();
+
+        for( const auto& it : used )
+        {
+            if( !_summary.empty() )
+                _summary += ", ";
+
+            _summary += std::to_string( it.second ) + "x " + PngEncoderSettingsToString( _candidates[it.first] );
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "AnimWriter.h"
+#include "PngEncoder.h"
+#include "PngImage.h"
+#include "PngPalette.h"
+#include "Sink.h"
+#include "ThreadPool.h"
+
+namespace frm2png
+{
+    // APNG writer which filters and deflates frames using thread pool
+    // chunks are written in sequence order as soon as all previous frames are finished
+    //
+    // if more than one candidate settings is given, every frame is compressed with each of them;
+    // color type giving smallest animation is used, and each frame is stored using its own best settings
+    // in that case nothing is written until animation is complete
+    class ApngWriter : public AnimWriter
+    {
+    protected:
+        struct Frame
+        {
+            // one result per candidate
+            std::vector<std::future<std::vector<uint8_t>>> Data;
+
+            uint32_t Width, Height;
+            uint32_t OffsetX, OffsetY;
+            uint16_t DelayNum, DelayDen;
+            uint8_t  Dispose, Blend;
+        };
+
+        std::unique_ptr<Sink> _ownSink;
+        Sink*                 _sink;
+        ThreadPool&           _pool;
+
+        std::vector<PngEncoderSettings>   _candidates;
+        std::shared_ptr<const PngPalette> _palette;
+
+        std::deque<Frame> _pending;
+
+        uint32_t _width = 0, _height = 0;
+        uint32_t _frames        = 0;
+        uint32_t _loop          = 0;
+        uint32_t _framesWritten = 0;
+        uint32_t _sequence      = 0;
+        bool     _preview       = false;
+
+        std::string _summary;
+
+    public:
+        // palette is required by indexed candidates only
+        // if factory is set, it creates sink for file instead of writing to disk
+        ApngWriter( const std::string& filename, ThreadPool& pool, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette = nullptr, SinkFactory* sinks = nullptr );
+        ApngWriter( Sink& sink, ThreadPool& pool, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette = nullptr );
+        ~ApngWriter();
+
+        virtual void writeAnimHeader( uint32_t width, uint32_t height, uint32_t frames, uint32_t loop, bool preview ) override;
+        virtual void writeAnimFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint16_t delayNum, uint16_t delayDen, uint8_t dispose, uint8_t blend ) override;
+        virtual void writeAnimEnd() override;
+
+        // describes settings used for frames; available after writeAnimEnd()
+        const std::string& summary() const;
+
+    protected:
+        // sink is owned by writer if ownSink is set; otherwise it must outlive writer
+        ApngWriter( std::unique_ptr<Sink> ownSink, Sink* sink, ThreadPool& pool, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette );
+
+        void writeHeader( bool indexed );
+        void writeFrame( const Frame& frame, const std::vector<uint8_t>& data );
+
+        // writes compressed frames, in order; if wait is false, stops at first frame which is still being compressed
+        void writeFrames( bool wait );
+        // selects best settings for all frames and writes them
+        void writeOptimized();
+    };
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace frm2png
+{
+    // fixed-capacity queue for any number of producers and consumers, without locks
+    // every cell carries sequence number telling if it's ready to be written or read in current lap over the ring, so threads
+    // only compete for head/tail position (see Dmitry Vyukov's bounded MPMC queue)
+    // blocking push()/pop() spin for a moment, then yield and sleep; full queue stalls producers, which limits memory used by
+    // values in flight between pipeline stages
+    template<typename T>
+    class BoundedQueue
+    {
+    protected:
+        struct Cell
+        {
+            std::atomic<std::size_t> Sequence;
+            T                        Value;
+        };
+
+        // head and tail are kept on separate cache lines, as they're written by different threads
+        std::unique_ptr<Cell[]>  _cells;
+        std::size_t              _mask;
+        std::atomic<bool>        _closed;
+        char                     _padding0[64];
+        std::atomic<std::size_t> _head; // next cell to pop
+        char                     _padding1[64];
+        std::atomic<std::size_t> _tail; // next cell to push
+        char                     _padding2[64];
+
+    public:
+        // capacity is rounded up to power of two
+        BoundedQueue( std::size_t capacity ) :
+            _closed( false ),
+            _head( 0 ),
+            _tail( 0 )
+        {
+            std::size_t size = 2;
+            while( size < capacity )
+                size *= 2;
+
+            _cells.reset( new Cell[size] );
+            _mask = size - 1;
+
+            for( std::size_t idx = 0; idx < size; idx++ )
+                _cells[idx].Sequence.store( idx, std::memory_order_relaxed );
+        }
+
+        BoundedQueue( const BoundedQueue& ) = delete;
+        BoundedQueue& operator=( const BoundedQueue& ) = delete;
+
+        // value is moved into queue only on success; returns false if queue is full
+        bool tryPush( T& value )
+        {
+            std::size_t pos = _tail.load( std::memory_order_relaxed );
+            Cell*       cell;
+
+            while( true )
+            {
+                cell                     = &_cells[pos & _mask];
+                const std::size_t   seq  = cell->Sequence.load( std::memory_order_acquire );
+                const std::intptr_t diff = static_cast<std::intptr_t>( seq ) - static_cast<std::intptr_t>( pos );
+
+                if( diff == 0 )
+                {
+                    if( _tail.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+                        break;
+                }
+                else if( diff < 0 )
+                    return false;
+                else
+                    pos = _tail.load( std::memory_order_relaxed );
+            }
+
+            cell->Value = std::move( value );
+            cell->Sequence.store( pos + 1, std::memory_order_release );
+
+            return true;
+        }
+
+        // returns false if queue is empty
+        bool tryPop( T& value )
+        {
+            std::size_t pos = _head.load( std::memory_order_relaxed );
+            Cell*       cell;
+
+            while( true )
+            {
+                cell                     = &_cells[pos & _mask];
+                const std::size_t   seq  = cell->Sequence.load( std::memory_order_acquire );
+                const std::intptr_t diff = static_cast<std::intptr_t>( seq ) - static_cast<std::intptr_t>( pos + 1 );
+
+                if( diff == 0 )
+                {
+                    if( _head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+                        break;
+                }
+                else if( diff < 0 )
+                    return false;
+                else
+                    pos = _head.load( std::memory_order_relaxed );
+            }
+
+            value = std::move( cell->Value );
+            cell->Sequence.store( pos + _mask + 1, std::memory_order_release );
+
+            return true;
+        }
+
+        // waits while queue is full; returns false if queue has been closed
+        bool push( T&& value )
+        {
+            for( unsigned attempt = 0; !closed(); attempt++ )
+            {
+                if( tryPush( value ) )
+                    return true;
+
+                Backoff( attempt );
+            }
+
+            return false;
+        }
+
+        // waits while queue is empty; returns false once queue has been closed and all values were taken
+        bool pop( T& value )
+        {
+            for( unsigned attempt = 0;; attempt++ )
+            {
+                if( tryPop( value ) )
+                    return true;
+                else if( closed() )
+                    return tryPop( value );
+
+                Backoff( attempt );
+            }
+        }
+
+        // push() fails from now on, pop() returns remaining values; values pushed by producers still running at this point may be lost
+        void close()
+        {
+            _closed.store( true, std::memory_order_release );
+        }
+
+        bool closed() const
+        {
+            return _closed.load( std::memory_order_acquire );
+        }
+
+    protected:
+        static void Backoff( unsigned attempt )
+        {
+            if( attempt < 64 )
+                return;
+            else if( attempt < 128 )
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+        }
+    };
+}
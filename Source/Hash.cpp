@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "Hash.h"
+
+namespace frm2png
+{
+    static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    static inline uint64_t Rotate( uint64_t value, unsigned bits )
+    {
+        return ( value << bits ) | ( value >> ( 64 - bits ) );
+    }
+
+    static inline uint64_t Round( uint64_t hash, uint64_t word )
+    {
+        return Rotate( hash ^ ( word * Prime2 ), 31 ) * Prime1;
+    }
+
+    // little endian load; compilers turn it into single read on little endian machines
+    static inline uint64_t Load( const uint8_t* bytes, std::size_t size )
+    {
+        uint64_t word = 0;
+
+        for( std::size_t idx = 0; idx < size; idx++ )
+            word |= static_cast<uint64_t>( bytes[idx] ) << ( idx * 8 );
+
+        return word;
+    }
+
+    // spreads every input bit over whole result
+    static inline uint64_t Avalanche( uint64_t hash )
+    {
+        hash ^= hash >> 33;
+        hash *= Prime2;
+        hash ^= hash >> 29;
+        hash *= Prime1;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+
+    uint64_t HashBytes( const void* data, std::size_t size, uint64_t seed /* = 0 */ )
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>( data );
+        uint64_t       hash  = seed ^ ( static_cast<uint64_t>( size ) * Prime1 );
+
+        // four independent lanes keep multiplier busy
+        if( size >= 32 )
+        {
+            uint64_t lanes[4] = { hash + Prime1, hash + Prime2, hash, hash - Prime1 };
+
+            for( ; size >= 32; bytes += 32, size -= 32 )
+            {
+                for( std::size_t lane = 0; lane < 4; lane++ )
+                    lanes[lane] = Round( lanes[lane], Load( bytes + lane * 8, 8 ) );
+            }
+
+            hash = Rotate( lanes[0], 1 ) + Rotate( lanes[1], 7 ) + Rotate( lanes[2], 12 ) + Rotate( lanes[3], 18 );
+        }
+
+        for( ; size >= 8; bytes += 8, size -= 8 )
+            hash = Round( hash, Load( bytes, 8 ) );
+
+        return Avalanche( Round( hash, Load( bytes, size ) ) );
+    }
+
+    uint64_t HashString( const std::string& text, uint64_t seed /* = 0 */ )
+    {
+        return HashBytes( text.data(), text.size(), seed );
+    }
+
+    uint64_t HashFile( const std::string& filename, uint64_t seed /* = 0 */ )
+    {
+        std::ifstream stream( filename, std::ios_base::in | std::ios_base::binary );
+        if( !stream.is_open() )
+            throw std::runtime_error( "HashFile() - Can't open input file: " + filename );
+
+        stream.seekg( 0, std::ios_base::end );
+        std::vector<char> content( static_cast<std::size_t>( stream.tellg() ) );
+        stream.seekg( 0, std::ios_base::beg );
+
+        if( !stream.read( content.data(), static_cast<std::streamsize>( content.size() ) ) )
+            throw std::runtime_error( "HashFile() - Can't read input file: " + filename );
+
+        return HashBytes( content.data(), content.size(), seed );
+    }
+
+    uint64_t HashCombine( uint64_t hash, uint64_t value )
+    {
+        return Avalanche( Round( hash, value ) );
+    }
+
+    std::string HashToString( uint64_t hash )
+    {
+        static const char* digits = "0123456789abcdef";
+
+        std::string result( 16, '0' );
+        for( std::size_t idx = 0; idx < 16; idx++, hash >>= 4 )
+            result[15 - idx] = digits[hash & 0xF];
+
+        return result;
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace frm2png
+{
+    // fast 64-bit hash, used to detect changed inputs; not suitable for anything security related
+    // result doesn't depend on platform endianness, so hashes can be compared between machines
+    uint64_t HashBytes( const void* data, std::size_t size, uint64_t seed = 0 );
+    uint64_t HashString( const std::string& text, uint64_t seed = 0 );
+
+    // hashes whole file content; throws if file cannot be read
+    uint64_t HashFile( const std::string& filename, uint64_t seed = 0 );
+
+    // mixes another hash or number into hash
+    uint64_t HashCombine( uint64_t hash, uint64_t value );
+
+    // 16 lowercase hex digits
+    std::string HashToString( uint64_t hash );
+}
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+// C++ standard includes
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// system includes
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined( _WIN32 )
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <direct.h>
+    #include <windows.h>
+#else
+    #include <dirent.h>
+#endif
+
+// frm2png includes
+#include "InputFiles.h"
+
+namespace frm2png
+{
+    struct DirectoryEntry
+    {
+        std::string Name;
+        bool        Directory;
+
+        bool operator<( const DirectoryEntry& other ) const
+        {
+            return Name < other.Name;
+        }
+    };
+
+#if defined( _WIN32 )
+    static const char* Separators = "/\\";
+#else
+    static const char* Separators = "/";
+#endif
+
+    static bool IsSeparator( char c )
+    {
+#if defined( _WIN32 )
+        return c == '/' || c == '\\';
+#else
+        return c == '/';
+#endif
+    }
+
+    static std::string JoinPath( const std::string& path, const std::string& name )
+    {
+        if( path.empty() || path == "." )
+            return name;
+        else if( IsSeparator( path.back() ) )
+            return path + name;
+
+        return path + "/" + name;
+    }
+
+    // symlinked directories are not followed, which prevents endless recursion
+    static std::vector<DirectoryEntry> ReadDirectory( const std::string& path )
+    {
+        std::vector<DirectoryEntry> result;
+
+#if defined( _WIN32 )
+        WIN32_FIND_DATAA data;
+        HANDLE           find = FindFirstFileA( JoinPath( path.empty() ? "." : path, "*" ).c_str(), &data );
+
+        if( find == INVALID_HANDLE_VALUE )
+            throw std::runtime_error( "ReadDirectory() - Can't open directory: " + path );
+
+        do
+        {
+            const std::string name = data.cFileName;
+            if( name == "." || name == ".." )
+                continue;
+
+            if( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+            {
+                if( !( data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) )
+                    result.push_back( { name, true } );
+            }
+            else
+                result.push_back( { name, false } );
+        }
+        while( FindNextFileA( find, &data ) );
+
+        FindClose( find );
+#else
+        DIR* dir = opendir( path.empty() ? "." : path.c_str() );
+        if( !dir )
+            throw std::runtime_error( "ReadDirectory() - Can't open directory: " + path );
+
+        while( const dirent* entry = readdir( dir ) )
+        {
+            const std::string name = entry->d_name;
+            if( name == "." || name == ".." )
+                continue;
+
+            const std::string full = JoinPath( path, name );
+            struct stat       info;
+
+            if( lstat( full.c_str(), &info ) != 0 )
+                continue;
+
+            if( S_ISDIR( info.st_mode ) )
+                result.push_back( { name, true } );
+            else if( S_ISREG( info.st_mode ) || ( S_ISLNK( info.st_mode ) && stat( full.c_str(), &info ) == 0 && S_ISREG( info.st_mode ) ) )
+                result.push_back( { name, false } );
+        }
+
+        closedir( dir );
+#endif
+
+        std::sort( result.begin(), result.end() );
+
+        return result;
+    }
+
+    InputFiles::InputFiles( const std::vector<std::string>& arguments ) :
+        _arguments( arguments )
+    {}
+
+    bool InputFiles::next( InputFile& file )
+    {
+        while( _found.empty() )
+        {
+            if( !_searches.empty() )
+            {
+                Search search = std::move( _searches.back() );
+                _searches.pop_back();
+
+                read( search );
+            }
+            else if( _argument < _arguments.size() )
+                start( _arguments[_argument++] );
+            else
+                return false;
+        }
+
+        file = std::move( _found.front() );
+        _found.pop_front();
+
+        return true;
+    }
+
+    void InputFiles::start( const std::string& argument )
+    {
+        _pattern.clear();
+
+        Search search;
+
+        if( !IsGlobPattern( argument ) )
+        {
+            if( !IsDirectory( argument ) )
+            {
+                // missing files are passed as well, and reported when opened
+                std::size_t pos = argument.find_last_of( Separators );
+                _found.push_back( { argument, pos == std::string::npos ? argument : argument.substr( pos + 1 ) } );
+
+                return;
+            }
+
+            search.Directory = argument;
+            _pattern         = { "**", "*.frm" };
+        }
+        else
+        {
+            // components before first one with wildcards are used as search root
+
+            std::size_t start = 0;
+            bool        root  = true;
+
+            if( IsSeparator( argument.front() ) )
+                search.Directory = argument.substr( 0, 1 );
+
+            while( start <= argument.size() )
+            {
+                std::size_t end = start;
+                while( end < argument.size() && !IsSeparator( argument[end] ) )
+                    end++;
+
+                const std::string component = argument.substr( start, end - start );
+                start                       = end + 1;
+
+                if( component.empty() || component == "." )
+                    continue;
+
+                if( root && !IsGlobPattern( component ) )
+                    search.Directory = JoinPath( search.Directory, component );
+                else
+                {
+                    root = false;
+                    _pattern.push_back( component );
+                }
+            }
+
+            if( search.Directory.empty() )
+                search.Directory = ".";
+        }
+
+        expand( search.Components, 0 );
+        _searches.push_back( std::move( search ) );
+    }
+
+    void InputFiles::read( const Search& search )
+    {
+        std::vector<Search> directories;
+
+        for( const DirectoryEntry& entry : ReadDirectory( search.Directory ) )
+        {
+            std::vector<std::size_t> components;
+            bool                     match = false;
+
+            for( std::size_t component : search.Components )
+            {
+                bool last = component + 1 == _pattern.size();
+
+                if( _pattern[component] == "**" )
+                {
+                    if( entry.Directory )
+                        expand( components, component );
+                    else if( last )
+                        match = true;
+                }
+                else if( MatchGlob( _pattern[component], entry.Name ) )
+                {
+                    if( last )
+                        match = true;
+                    else if( entry.Directory )
+                        expand( components, component + 1 );
+                }
+            }
+
+            const std::string filename = JoinPath( search.Directory, entry.Name );
+            const std::string relative = search.Relative.empty() ? entry.Name : search.Relative + "/" + entry.Name;
+
+            if( !entry.Directory && match )
+                _found.push_back( { filename, relative } );
+            else if( entry.Directory && !components.empty() )
+                directories.push_back( { filename, relative, std::move( components ) } );
+        }
+
+        // subdirectories are read in sorted order, before directories found earlier
+        _searches.insert( _searches.end(), std::make_move_iterator( directories.rbegin() ), std::make_move_iterator( directories.rend() ) );
+    }
+
+    void InputFiles::expand( std::vector<std::size_t>& components, std::size_t component ) const
+    {
+        for( ; component < _pattern.size(); component++ )
+        {
+            if( std::find( components.begin(), components.end(), component ) == components.end() )
+                components.push_back( component );
+
+            if( _pattern[component] != "**" )
+                break;
+        }
+    }
+
+    bool IsGlobPattern( const std::string& pattern )
+    {
+        return pattern.find_first_of( "*?" ) != std::string::npos;
+    }
+
+    bool MatchGlob( const std::string& pattern, const std::string& name )
+    {
+        // on mismatch, last '*' consumes one more character and matching restarts after it
+
+        std::size_t p = 0, n = 0;
+        std::size_t star = std::string::npos, starName = 0;
+
+        while( n < name.size() )
+        {
+            if( p < pattern.size() && pattern[p] == '*' )
+            {
+                star     = p++;
+                starName = n;
+            }
+            else if( p < pattern.size() && ( pattern[p] == '?' || std::tolower( static_cast<unsigned char>( pattern[p] ) ) == std::tolower( static_cast<unsigned char>( name[n] ) ) ) )
+            {
+                p++;
+                n++;
+            }
+            else if( star != std::string::npos )
+            {
+                p = star + 1;
+                n = ++starName;
+            }
+            else
+                return false;
+        }
+
+        while( p < pattern.size() && pattern[p] == '*' )
+            p++;
+
+        return p == pattern.size();
+    }
+
+    bool IsDirectory( const std::string& path )
+    {
+        struct stat info;
+
+        return stat( path.c_str(), &info ) == 0 && ( info.st_mode & S_IFMT ) == S_IFDIR;
+    }
+
+    bool IsFile( const std::string& path )
+    {
+        struct stat info;
+
+        return stat( path.c_str(), &info ) == 0 && ( info.st_mode & S_IFMT ) == S_IFREG;
+    }
+
+    void CreateDirectories( const std::string& path )
+    {
+        for( std::size_t pos = 0; pos <= path.size(); pos++ )
+        {
+            if( pos < path.size() && !IsSeparator( path[pos] ) )
+                continue;
+
+            const std::string directory = path.substr( 0, pos );
+
+            // skip filesystem root and drive letters
+            if( directory.empty() || directory.back() == ':' || IsDirectory( directory ) )
+                continue;
+
+#if defined( _WIN32 )
+            int result = _mkdir( directory.c_str() );
+#else
+            int result = mkdir( directory.c_str(), 0777 );
+#endif
+
+            // directory might be created by another thread in meantime
+            if( result != 0 && !IsDirectory( directory ) )
+                throw std::runtime_error( "CreateDirectories() - Can't create directory: " + directory );
+        }
+    }
+}
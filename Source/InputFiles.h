@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace frm2png
+{
+    // single file found by InputFiles
+    struct InputFile
+    {
+        // path used to open file
+        std::string Filename;
+
+        // path relative to directory given by user, or to non-pattern part of glob; used to recreate input tree in output directory
+        std::string Relative;
+    };
+
+    // lazily enumerates files passed on command line
+    // each argument can be a file, a directory (searched recursively for .frm files) or a glob pattern ('*', '?', '**' matches any number of directories)
+    // directories are read one at a time, only when all files found so far are used, so caller can start working before whole tree is scanned
+    // patterns ignore case; entries of each directory are returned in sorted order, files before subdirectories
+    class InputFiles
+    {
+    protected:
+        // directory waiting to be read; Components lists pattern components which can match its entries
+        struct Search
+        {
+            std::string              Directory;
+            std::string              Relative;
+            std::vector<std::size_t> Components;
+        };
+
+        std::vector<std::string> _arguments;
+        std::size_t              _argument = 0;
+
+        std::vector<std::string> _pattern;
+        std::vector<Search>      _searches;
+        std::deque<InputFile>    _found;
+
+    public:
+        InputFiles( const std::vector<std::string>& arguments );
+
+        // returns false when there are no more files
+        bool next( InputFile& file );
+
+    protected:
+        void start( const std::string& argument );
+        void read( const Search& search );
+
+        // adds component index, and indexes following '**' components
+        void expand( std::vector<std::size_t>& components, std::size_t component ) const;
+    };
+
+    bool IsGlobPattern( const std::string& pattern );
+    bool MatchGlob( const std::string& pattern, const std::string& name );
+
+    bool IsDirectory( const std::string& path );
+    bool IsFile( const std::string& path );
+
+    // creates directory and all missing parents
+    void CreateDirectories( const std::string& path );
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// frm2png includes
+#include "InputPrefetch.h"
+#include "Stdio.h"
+
+namespace frm2png
+{
+    InputPrefetch::Reader::Reader( std::size_t depth ) :
+        Pending( depth ),
+        Ready( depth )
+    {}
+
+    InputPrefetch::InputPrefetch( InputFiles& inputs, std::size_t readers, std::size_t depth ) :
+        _inputs( inputs )
+    {
+        if( !readers )
+            readers = 1;
+
+        for( std::size_t idx = 0; idx < readers; idx++ )
+            _readers.emplace_back( new Reader( depth ) );
+
+        for( std::unique_ptr<Reader>& reader : _readers )
+        {
+            Reader* ptr    = reader.get();
+            reader->Thread = std::thread( [this, ptr]() { read( *ptr ); } );
+        }
+
+        _enumerator = std::thread( [this]() { enumerate(); } );
+    }
+
+    InputPrefetch::~InputPrefetch()
+    {
+        // caller can stop early (e.g. after conversion error); closing all queues makes every stage stop at next push
+        for( std::unique_ptr<Reader>& reader : _readers )
+        {
+            reader->Pending.close();
+            reader->Ready.close();
+        }
+
+        _enumerator.join();
+
+        for( std::unique_ptr<Reader>& reader : _readers )
+            reader->Thread.join();
+    }
+
+    bool InputPrefetch::next( PrefetchedFile& file )
+    {
+        // files were dealt in turns, so when reader runs out, all following readers ran out as well
+        if( !_readers[_next % _readers.size()]->Ready.pop( file ) )
+        {
+            if( _error )
+                std::rethrow_exception( _error );
+
+            return false;
+        }
+
+        file.Index = _next++;
+
+        return true;
+    }
+
+    void InputPrefetch::enumerate()
+    {
+        try
+        {
+            InputFile   input;
+            std::size_t count = 0;
+
+            while( _inputs.next( input ) )
+            {
+                if( !_readers[count++ % _readers.size()]->Pending.push( std::move( input ) ) )
+                    break;
+            }
+        }
+        catch( ... )
+        {
+            _error = std::current_exception();
+        }
+
+        for( std::unique_ptr<Reader>& reader : _readers )
+            reader->Pending.close();
+    }
+
+    void InputPrefetch::read( Reader& reader )
+    {
+        PrefetchedFile file;
+
+        while( reader.Pending.pop( file.Input ) )
+        {
+            if( !IsStdio( file.Input.Filename ) )
+                file.Content = ReadInputFile( file.Input.Filename );
+
+            if( !reader.Ready.push( std::move( file ) ) )
+                break;
+
+            file = PrefetchedFile();
+        }
+
+        reader.Ready.close();
+    }
+
+    std::shared_ptr<const std::vector<char>> ReadInputFile( const std::string& filename )
+    {
+        std::ifstream stream( filename, std::ios_base::in | std::ios_base::binary );
+        if( !stream.is_open() )
+            return nullptr;
+
+        stream.seekg( 0, std::ios_base::end );
+        const std::streamoff size = stream.tellg();
+        if( size < 0 )
+            return nullptr;
+
+        std::shared_ptr<std::vector<char>> content = std::make_shared<std::vector<char>>( static_cast<std::size_t>( size ) );
+        stream.seekg( 0, std::ios_base::beg );
+
+        if( !stream.read( content->data(), static_cast<std::streamsize>( content->size() ) ) )
+            return nullptr;
+
+        return content;
+    }
+}
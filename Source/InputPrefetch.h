@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// frm2png includes
+#include "BoundedQueue.h"
+#include "InputFiles.h"
+
+namespace frm2png
+{
+    // input file with its content already in memory
+    struct PrefetchedFile
+    {
+        InputFile Input;
+
+        // not set for stdin, or if file couldn't be read; file is opened again by whoever needs it, which reports the error
+        std::shared_ptr<const std::vector<char>> Content;
+
+        // position in original order, starting from 0
+        std::size_t Index = 0;
+    };
+
+    // reads input files ahead on separate threads, so slow storage is hidden behind conversion of previous files
+    // one thread enumerates files and deals them to readers in turns; each reader has its own queues, so files come out in original order
+    // number of files held in memory is limited by queue depth; stages wait for each other when queues are full or empty
+    class InputPrefetch
+    {
+    protected:
+        struct Reader
+        {
+            BoundedQueue<InputFile>      Pending;
+            BoundedQueue<PrefetchedFile> Ready;
+            std::thread                  Thread;
+
+            Reader( std::size_t depth );
+        };
+
+        InputFiles&                          _inputs;
+        std::vector<std::unique_ptr<Reader>> _readers;
+        std::size_t                          _next = 0;
+        std::thread                          _enumerator;
+
+        // set by enumerator if InputFiles fails; rethrown by next() after all files found so far
+        std::exception_ptr _error;
+
+    public:
+        InputPrefetch( InputFiles& inputs, std::size_t readers, std::size_t depth );
+        ~InputPrefetch();
+
+        InputPrefetch( const InputPrefetch& ) = delete;
+        InputPrefetch& operator=( const InputPrefetch& ) = delete;
+
+        // returns false when there are no more files
+        bool next( PrefetchedFile& file );
+
+    protected:
+        void enumerate();
+        void read( Reader& reader );
+    };
+
+    // returns nullptr if file can't be read
+    std::shared_ptr<const std::vector<char>> ReadInputFile( const std::string& filename );
+}
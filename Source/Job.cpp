@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// system includes
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// frm2png includes
+#include "ColorPal.h"
+#include "InputFiles.h"
+#include "Job.h"
+#include "PngFilter.h"
+#include "PngScale.h"
+#include "Sidecar.h"
+#include "Split.h"
+#include "Stdio.h"
+
+// falltergeist includes
+#include "Format/Dat/Entry.h"
+#include "Format/Dat/Stream.h"
+#include "Format/Frm/File.h"
+
+namespace frm2png
+{
+    static const std::vector<std::string> JobFields = { "input", "dat", "pal", "palette", "generator", "format", "delta", "filter", "optimize", "metadata", "scale", "thumbnail-size", "output" };
+
+    // changes whenever file is modified; throws if file cannot be accessed
+    static std::string GetStamp( const std::string& filename )
+    {
+        struct stat info;
+        if( stat( filename.c_str(), &info ) != 0 )
+            throw std::runtime_error( "GetStamp() - Can't open input file: " + filename );
+
+        return std::to_string( static_cast<long long>( info.st_mtime ) ) + ":" + std::to_string( static_cast<long long>( info.st_size ) );
+    }
+
+    Job::Job( const std::string& line )
+    {
+        if( line.empty() )
+            return;
+
+        for( const std::string& field : SplitList( line, '\t' ) )
+        {
+            size_t pos = field.find( '=' );
+            if( pos == std::string::npos || pos == 0 )
+                throw std::runtime_error( "Job() - Invalid field: '" + field + "'" );
+
+            const std::string name = field.substr( 0, pos );
+            if( std::find( JobFields.begin(), JobFields.end(), name ) == JobFields.end() )
+                throw std::runtime_error( "Job() - Unknown field: '" + name + "'" );
+
+            Fields[name] = field.substr( pos + 1 );
+        }
+    }
+
+    std::string Job::get( const std::string& name, const std::string& fallback /* = "" */ ) const
+    {
+        auto it = Fields.find( name );
+
+        return it != Fields.end() && !it->second.empty() ? it->second : fallback;
+    }
+
+    unsigned Job::number( const std::string& name, unsigned fallback ) const
+    {
+        const std::string value = get( name );
+        if( value.empty() )
+            return fallback;
+
+        if( value.size() > 9 || !std::all_of( value.begin(), value.end(), []( char c ) { return std::isdigit( static_cast<unsigned char>( c ) ) != 0; } ) )
+            throw std::runtime_error( "Job::number() - Invalid value of '" + name + "': '" + value + "'" );
+
+        return static_cast<unsigned>( std::stoul( value ) );
+    }
+
+    std::vector<Job> ReadJobs( const std::string& filename )
+    {
+        std::ifstream stream( filename );
+        if( !stream.is_open() )
+            throw std::runtime_error( "ReadJobs() - Can't open jobs file: " + filename );
+
+        std::vector<Job> jobs;
+        std::string      line;
+
+        for( std::size_t number = 1; std::getline( stream, line ); number++ )
+        {
+            if( !line.empty() && line.back() == '\r' )
+                line.pop_back();
+
+            if( line.empty() || line.front() == '#' )
+                continue;
+
+            try
+            {
+                jobs.emplace_back( line );
+            }
+            catch( std::exception& e )
+            {
+                throw std::runtime_error( "ReadJobs() - " + filename + ":" + std::to_string( number ) + ": " + e.what() );
+            }
+
+            jobs.back().Line = number;
+
+            if( jobs.back().get( "input" ).empty() )
+                throw std::runtime_error( "ReadJobs() - " + filename + ":" + std::to_string( number ) + ": Missing field: 'input'" );
+        }
+
+        return jobs;
+    }
+
+    JobSources::Archive::Archive( const std::string& filename, const std::string& stamp ) :
+        Stamp( stamp ),
+        File( filename )
+    {}
+
+    JobSources::JobSources( std::size_t limit ) :
+        _files( limit )
+    {}
+
+    std::shared_ptr<const std::vector<char>> JobSources::frm( const Job& job, std::string& key )
+    {
+        const std::string input = job.get( "input" );
+        const std::string dat   = job.get( "dat" );
+
+        if( input.empty() )
+            throw std::runtime_error( "JobSources::frm() - Missing field: 'input'" );
+
+        if( !dat.empty() )
+            return read( dat, input, key );
+        else if( IsStdio( input ) )
+        {
+            key = "stdin";
+            return std::make_shared<const std::vector<char>>( ReadStdin() );
+        }
+
+        return read( input, key );
+    }
+
+    std::shared_ptr<const PaletteTable> JobSources::palette( const Job& job, std::string& key )
+    {
+        const std::string palFile = job.get( "pal" );
+        const std::string palName = job.get( "palette", "default" );
+
+        if( IsStdio( palFile ) )
+            key = "stdin";
+        else if( !palFile.empty() )
+            key = "file\n" + palFile + "\n" + GetStamp( palFile );
+        else
+            key = "name\n" + palName;
+
+        return _palettes.get( key, 4 /* noon */, [this, &palFile, &palName]() {
+            if( !palFile.empty() )
+            {
+                std::string                              contentKey;
+                std::shared_ptr<const std::vector<char>> content = IsStdio( palFile ) ? std::make_shared<const std::vector<char>>( ReadStdin() ) : read( palFile, contentKey );
+
+                return Falltergeist::Format::Pal::File( Falltergeist::Format::Dat::Stream( content->data(), content->size() ) );
+            }
+
+            auto it = ColorPal.find( palName );
+            if( it == ColorPal.end() )
+                throw std::runtime_error( "JobSources::palette() - unknown palette name '" + palName + "'" );
+
+            return Falltergeist::Format::Pal::File( it->second );
+        } );
+    }
+
+    std::shared_ptr<const std::vector<char>> JobSources::read( const std::string& filename, std::string& key )
+    {
+        key = "file\n" + filename + "\n" + GetStamp( filename );
+
+        std::shared_ptr<const std::vector<char>> content = _files.find( key );
+        if( content )
+            return content;
+
+        std::ifstream stream( filename, std::ios_base::in | std::ios_base::binary );
+        if( !stream.is_open() )
+            throw std::runtime_error( "JobSources::read() - Can't open input file: " + filename );
+
+        stream.seekg( 0, std::ios_base::end );
+        std::shared_ptr<std::vector<char>> data = std::make_shared<std::vector<char>>( static_cast<std::size_t>( stream.tellg() ) );
+        stream.seekg( 0, std::ios_base::beg );
+
+        if( !stream.read( data->data(), static_cast<std::streamsize>( data->size() ) ) )
+            throw std::runtime_error( "JobSources::read() - Can't read input file: " + filename );
+
+        _files.add( key, data, data->size() );
+
+        return data;
+    }
+
+    std::shared_ptr<const std::vector<char>> JobSources::read( const std::string& datname, const std::string& filename, std::string& key )
+    {
+        // entries names are stored in lowercase, with '/' as separator
+        std::string entryname = filename;
+        std::replace( entryname.begin(), entryname.end(), '\\', '/' );
+        std::transform( entryname.begin(), entryname.end(), entryname.begin(), []( char c ) { return static_cast<char>( std::tolower( static_cast<unsigned char>( c ) ) ); } );
+
+        const std::string stamp = GetStamp( datname );
+        key                     = "dat\n" + datname + "\n" + stamp + "\n" + entryname;
+
+        std::shared_ptr<const std::vector<char>> content = _files.find( key );
+        if( content )
+            return content;
+
+        // archive is opened again if it changed since it was used last time
+        Archive* archive;
+        {
+            std::lock_guard<std::mutex> lock( _archivesLock );
+
+            std::unique_ptr<Archive>& opened = _archives[datname];
+            if( !opened || opened->Stamp != stamp )
+                opened.reset( new Archive( datname, stamp ) );
+
+            archive = opened.get();
+        }
+
+        std::lock_guard<std::mutex> lock( archive->Lock );
+
+        Falltergeist::Format::Dat::Entry* entry = archive->File.entry( entryname );
+        if( !entry )
+            throw std::runtime_error( "JobSources::read() - Can't find '" + filename + "' in " + datname );
+
+        Falltergeist::Format::Dat::Stream  stream( *entry );
+        std::shared_ptr<std::vector<char>> data = std::make_shared<std::vector<char>>( stream.size() );
+        stream.readBytes( reinterpret_cast<uint8_t*>( data->data() ), data->size() );
+
+        _files.add( key, data, data->size() );
+
+        return data;
+    }
+
+    void RunJob( const Job& job, JobSources& sources, ThreadPool& pool, SinkFactory* sinks, PngOutputList* outputs, Logging& logVerbose )
+    {
+        // validate settings before loading anything
+
+        std::vector<OutputFormat> formats;
+        for( const std::string& name : SplitList( job.get( "format", "png" ) ) )
+        {
+            OutputFormat format;
+            if( !OutputFormatFromString( name, format ) )
+                throw std::runtime_error( "RunJob() - Unknown output format: '" + name + "'" );
+
+            formats.push_back( format );
+        }
+
+        PngEncoderSettings encoder;
+        if( !PngFilterModeFromString( job.get( "filter", "sum" ), encoder.Filter ) )
+            throw std::runtime_error( "RunJob() - Unknown filter mode: '" + job.get( "filter" ) + "'" );
+
+        SidecarFormat metadata;
+        if( !SidecarFormatFromString( job.get( "metadata", "none" ), metadata ) )
+            throw std::runtime_error( "RunJob() - Unknown metadata format: '" + job.get( "metadata" ) + "'" );
+        if( metadata != SidecarFormat::None && std::find( formats.begin(), formats.end(), OutputFormat::QoiFrames ) != formats.end() )
+            throw std::runtime_error( "RunJob() - Metadata cannot be used with qoi-frames format" );
+
+        const unsigned delta     = job.number( "delta", 0 );
+        const unsigned optimize  = job.number( "optimize", 0 );
+        const unsigned scale     = job.number( "scale", 1 );
+        const unsigned thumbnail = job.number( "thumbnail-size", 64 );
+
+        if( delta > 1 )
+            throw std::runtime_error( "RunJob() - Invalid value of 'delta': '" + job.get( "delta" ) + "'" );
+
+        if( scale != 1 && ( scale > UINT8_MAX || !PngScaleFactorSupported( static_cast<uint8_t>( scale ) ) ) )
+            throw std::runtime_error( "RunJob() - Unsupported scale factor: '" + std::to_string( scale ) + "'" );
+
+        std::string                              frmKey, palKey;
+        std::shared_ptr<const std::vector<char>> frmData = sources.frm( job, frmKey );
+
+        PngGeneratorData data( Falltergeist::Format::Frm::File( Falltergeist::Format::Dat::Stream( frmData->data(), frmData->size() ) ), sources.palette( job, palKey ) );
+
+        data.Format        = formats.front();
+        data.AnimDelta     = delta != 0;
+        data.Pool          = &pool;
+        data.Encoder       = encoder;
+        data.Optimize      = optimize;
+        data.Metadata      = metadata;
+        data.ThumbnailSize = thumbnail;
+        data.Sinks         = sinks;
+        data.Outputs       = outputs;
+
+        // output filename defaults to input filename, with extension of first format
+
+        std::string input = job.get( "input" );
+        std::replace( input.begin(), input.end(), '\\', '/' );
+
+        if( sinks || job.get( "output" ).empty() )
+        {
+            SplitFilename( IsStdio( input ) ? "stdin" : input, data.PngPath, data.PngBasename, data.PngExtension );
+            data.PngExtension = OutputFormatExtension( formats.front() );
+
+            if( sinks )
+                data.PngPath.clear();
+        }
+        else
+            SplitFilename( job.get( "output" ), data.PngPath, data.PngBasename, data.PngExtension );
+
+        logVerbose << "png = path[" + data.PngPath + "] basename[" + data.PngBasename + "] extension[" + data.PngExtension + "]";
+
+        if( !sinks && !data.PngPath.empty() )
+            CreateDirectories( data.PngPath );
+
+        if( scale != 1 )
+        {
+            logVerbose << "scale = " + std::to_string( scale );
+            PngScaleFrm( data.Frm, static_cast<uint8_t>( scale ), data.Pool );
+        }
+
+        RunPngGenerators( data, SplitList( job.get( "generator", "auto" ) ), formats, logVerbose );
+    }
+}
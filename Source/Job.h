@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "Logging.h"
+#include "LruCache.h"
+#include "PaletteTable.h"
+#include "PngGenerator.h"
+#include "Sink.h"
+#include "ThreadPool.h"
+
+// falltergeist includes
+#include "Format/Dat/File.h"
+
+namespace frm2png
+{
+    // conversion of single file, described by key=value fields; used by --jobs file and server requests
+    //   input=<file> [dat=<archive>] [pal=<file> | palette=<name>] [generator=<list>] [format=<list>] [delta=0|1]
+    //   [filter=<mode>] [optimize=<N>] [metadata=<format>] [scale=<N>] [thumbnail-size=<N>] [output=<file>]
+    // fields use same values as command line options; input is name of entry when dat is set
+    class Job
+    {
+    public:
+        std::map<std::string, std::string> Fields;
+
+        // position in jobs file, used in error messages
+        std::size_t Line = 0;
+
+    public:
+        Job() = default;
+
+        // tab separated key=value fields; throws on malformed or unknown field
+        Job( const std::string& line );
+
+        std::string get( const std::string& name, const std::string& fallback = "" ) const;
+        unsigned    number( const std::string& name, unsigned fallback ) const;
+    };
+
+    // reads one job per line; empty lines and lines starting with '#' are skipped
+    std::vector<Job> ReadJobs( const std::string& filename );
+
+    // inputs shared between jobs, each loaded once: contents of .frm files, palettes, opened .dat archives
+    // safe to use by multiple threads
+    class JobSources
+    {
+    protected:
+        // reading entry moves file position, so only one thread can use archive at a time
+        struct Archive
+        {
+            std::mutex                      Lock;
+            std::string                     Stamp;
+            Falltergeist::Format::Dat::File File;
+
+            Archive( const std::string& filename, const std::string& stamp );
+        };
+
+        LruCache<std::vector<char>>                     _files;
+        PaletteRegistry                                 _palettes;
+        std::mutex                                      _archivesLock;
+        std::map<std::string, std::unique_ptr<Archive>> _archives;
+
+    public:
+        // limit of memory used for contents of .frm files
+        JobSources( std::size_t limit );
+
+        // content of .frm file (unpacked, if it comes from archive)
+        // key identifies content, and changes whenever source file is modified
+        std::shared_ptr<const std::vector<char>> frm( const Job& job, std::string& key );
+
+        // palette with colors already multiplied; key as above
+        std::shared_ptr<const PaletteTable> palette( const Job& job, std::string& key );
+
+    protected:
+        std::shared_ptr<const std::vector<char>> read( const std::string& filename, std::string& key );
+        std::shared_ptr<const std::vector<char>> read( const std::string& datname, const std::string& filename, std::string& key );
+    };
+
+    // validates settings, loads inputs and runs generators
+    // files are created by sinks if set, named after input; otherwise they're written to output (default: next to input, with directories created as needed)
+    // outputs (if set) receives names of written files
+    void RunJob( const Job& job, JobSources& sources, ThreadPool& pool, SinkFactory* sinks, PngOutputList* outputs, Logging& logVerbose );
+}
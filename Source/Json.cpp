@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// frm2png includes
+#include "Json.h"
+
+namespace frm2png
+{
+    JsonWriter& JsonWriter::beginObject()
+    {
+        separator();
+        _json += '{';
+        _first.push_back( true );
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::endObject()
+    {
+        _json += '}';
+        _first.pop_back();
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::beginArray()
+    {
+        separator();
+        _json += '[';
+        _first.push_back( true );
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::endArray()
+    {
+        _json += ']';
+        _first.pop_back();
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::key( const std::string& name )
+    {
+        value( name );
+        _json += ':';
+        _afterKey = true;
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::value( const std::string& text )
+    {
+        separator();
+
+        _json += '"';
+        for( const char c : text )
+        {
+            if( c == '"' || c == '\\' )
+            {
+                _json += '\\';
+                _json += c;
+            }
+            else if( static_cast<unsigned char>( c ) < 0x20 )
+            {
+                char escaped[8];
+                std::snprintf( escaped, sizeof( escaped ), "\\u%04x", c );
+                _json += escaped;
+            }
+            else
+                _json += c;
+        }
+        _json += '"';
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::value( const char* text )
+    {
+        return value( std::string( text ) );
+    }
+
+    JsonWriter& JsonWriter::value( int64_t number )
+    {
+        separator();
+        _json += std::to_string( number );
+
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::boolean( bool flag )
+    {
+        separator();
+        _json += flag ? "true" : "false";
+
+        return *this;
+    }
+
+    const std::string& JsonWriter::str() const
+    {
+        return _json;
+    }
+
+    void JsonWriter::separator()
+    {
+        if( _afterKey )
+        {
+            _afterKey = false;
+            return;
+        }
+
+        if( _first.empty() )
+            return;
+
+        if( !_first.back() )
+            _json += ',';
+
+        _first.back() = false;
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace frm2png
+{
+    // minimal writer of compact JSON documents; caller is responsible for correct nesting
+    class JsonWriter
+    {
+    protected:
+        std::string _json;
+
+        // _first[N] = nesting level N, no values written yet
+        std::vector<bool> _first;
+        bool              _afterKey = false;
+
+    public:
+        JsonWriter& beginObject();
+        JsonWriter& endObject();
+        JsonWriter& beginArray();
+        JsonWriter& endArray();
+
+        JsonWriter& key( const std::string& name );
+
+        JsonWriter& value( const std::string& text );
+        JsonWriter& value( const char* text );
+        JsonWriter& value( int64_t number );
+        JsonWriter& boolean( bool flag );
+
+        const std::string& str() const;
+
+    protected:
+        void separator();
+    };
+}
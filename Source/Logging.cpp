@@ -32,6 +32,8 @@
 
 namespace frm2png
 {
+    const std::size_t Logging::ReportIndent;
+
     Logging::Logging( bool enabled /* = false */, bool cache /* = false */, size_t indent /* = 0 */ ) :
         Enabled( enabled ),
         Cache( cache ),
@@ -45,6 +47,25 @@ namespace frm2png
         Cached.clear();
     }
 
+    void Logging::Replay( const Logging& other )
+    {
+        const std::size_t indent = Indent;
+
+        for( const auto& message : other.Cached )
+        {
+            if( message.first == ReportIndent )
+            {
+                Report( message.second );
+                continue;
+            }
+
+            Indent = message.first;
+            *this << message.second;
+        }
+
+        Indent = indent;
+    }
+
     Logging& Logging::operator<<( const int8_t& indent )
     {
         if( Enabled )
@@ -65,4 +86,14 @@ namespace frm2png
 
         return *this;
     }
+
+    Logging& Logging::Report( const std::string& message )
+    {
+        if( Cache )
+            Cached.push_back( std::make_pair( ReportIndent, message ) );
+        else
+            std::cout << message << std::endl;
+
+        return *this;
+    }
 }
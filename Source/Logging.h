@@ -37,15 +37,25 @@ namespace frm2png
         bool        Cache;
         std::size_t Indent;
 
+        // indentation + message; reports use ReportIndent
         std::vector<std::pair<std::size_t, std::string>> Cached;
 
+        static const std::size_t ReportIndent = static_cast<std::size_t>( -1 );
+
     public:
         Logging( bool enabled = false, bool cache = false, size_t indent = 0 );
 
     public:
         void Clear();
 
+        // passes all messages cached by other instance, keeping their indentation
+        void Replay( const Logging& other );
+
         Logging& operator<<( const int8_t& indent );
         Logging& operator<<( const std::string& message );
+
+        // message printed as it is, even if logging is disabled; used for results requested by user (e.g. --optimize summary)
+        // cached the same way as other messages, so reports of files converted in parallel are printed in original order
+        Logging& Report( const std::string& message );
     };
 }
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace frm2png
+{
+    // keeps most recently used values, until their total cost exceeds limit; safe to use by multiple threads
+    // values are shared, so they stay valid for users even after being dropped from cache
+    template<typename T>
+    class LruCache
+    {
+    protected:
+        struct Item
+        {
+            std::string              Key;
+            std::shared_ptr<const T> Value;
+            std::size_t              Cost;
+        };
+
+        std::mutex                                                          _lock;
+        std::list<Item>                                                     _items; // most recently used first
+        std::unordered_map<std::string, typename std::list<Item>::iterator> _index;
+        std::size_t                                                         _cost = 0;
+        const std::size_t                                                   _limit;
+
+    public:
+        LruCache( std::size_t limit ) :
+            _limit( limit )
+        {}
+
+        std::shared_ptr<const T> find( const std::string& key )
+        {
+            std::lock_guard<std::mutex> lock( _lock );
+
+            auto it = _index.find( key );
+            if( it == _index.end() )
+                return nullptr;
+
+            _items.splice( _items.begin(), _items, it->second );
+
+            return it->second->Value;
+        }
+
+        // values more expensive than whole cache are not stored
+        void add( const std::string& key, std::shared_ptr<const T> value, std::size_t cost )
+        {
+            std::lock_guard<std::mutex> lock( _lock );
+
+            auto it = _index.find( key );
+            if( it != _index.end() )
+            {
+                _cost -= it->second->Cost;
+                _items.erase( it->second );
+                _index.erase( it );
+            }
+
+            if( cost > _limit )
+                return;
+
+            _items.push_front( { key, std::move( value ), cost } );
+            _index[key] = _items.begin();
+            _cost += cost;
+
+            while( _cost > _limit )
+            {
+                _cost -= _items.back().Cost;
+                _index.erase( _items.back().Key );
+                _items.pop_back();
+            }
+        }
+    };
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+// C++ standard includes
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "InputFiles.h"
+#include "Manifest.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+    // text file; header line, then each entry as key + tab + input filename, followed by tab + output filename lines
+    static const std::string ManifestHeader = "frm2png manifest 1";
+
+    Manifest::Manifest( const std::string& filename ) :
+        _filename( filename )
+    {
+        std::ifstream stream( filename );
+        if( !stream.is_open() )
+            return;
+
+        std::string line;
+        if( !std::getline( stream, line ) || line != ManifestHeader )
+            throw std::runtime_error( "Manifest::Manifest() - Unknown manifest format: " + filename );
+
+        Entry* entry = nullptr;
+        while( std::getline( stream, line ) )
+        {
+            const std::string::size_type tab = line.find( '\t' );
+            if( tab == std::string::npos )
+                throw std::runtime_error( "Manifest::Manifest() - Invalid manifest line: " + line );
+
+            if( tab == 0 && entry )
+                entry->Outputs.push_back( line.substr( 1 ) );
+            else if( tab > 0 )
+            {
+                entry      = &_entries[line.substr( tab + 1 )];
+                entry->Key = line.substr( 0, tab );
+                entry->Outputs.clear();
+            }
+            else
+                throw std::runtime_error( "Manifest::Manifest() - Invalid manifest line: " + line );
+        }
+    }
+
+    bool Manifest::unchanged( const std::string& input, const std::string& key )
+    {
+        std::lock_guard<std::mutex> lock( _mutex );
+
+        auto it = _entries.find( input );
+        if( it == _entries.end() || it->second.Key != key || it->second.Outputs.empty() )
+            return false;
+
+        for( const std::string& output : it->second.Outputs )
+        {
+            if( !IsFile( output ) )
+                return false;
+        }
+
+        return true;
+    }
+
+    void Manifest::update( const std::string& input, const std::string& key, const std::vector<std::string>& outputs )
+    {
+        std::lock_guard<std::mutex> lock( _mutex );
+
+        _entries[input] = { key, outputs };
+    }
+
+    void Manifest::write()
+    {
+        std::lock_guard<std::mutex> lock( _mutex );
+
+        std::string text = ManifestHeader + "\n";
+        for( const auto& entry : _entries )
+        {
+            text += entry.second.Key + "\t" + entry.first + "\n";
+
+            for( const std::string& output : entry.second.Outputs )
+                text += "\t" + output + "\n";
+        }
+
+        FileSink sink( _filename, text.size() );
+        sink.write( reinterpret_cast<const uint8_t*>( text.data() ), text.size() );
+        sink.close();
+    }
+}
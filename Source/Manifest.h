@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#pragma once
+
+// C++ standard includes
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace frm2png
+{
+    // results of previous runs, used to skip input files which would be converted into the same outputs again
+    // each input file is stored with key describing its content and all settings affecting outputs, and list of created files
+    // entries of files not converted in current run are kept
+    class Manifest
+    {
+    protected:
+        struct Entry
+        {
+            std::string              Key;
+            std::vector<std::string> Outputs;
+        };
+
+        std::string                  _filename;
+        std::map<std::string, Entry> _entries;
+        std::mutex                   _mutex;
+
+    public:
+        // loads manifest if file exists
+        Manifest( const std::string& filename );
+
+        // returns true if input was converted using same key before, and all its outputs still exist
+        bool unchanged( const std::string& input, const std::string& key );
+
+        void update( const std::string& input, const std::string& key, const std::vector<std::string>& outputs );
+
+        void write();
+    };
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+// C++ standard includes
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// system includes
+#if defined( _WIN32 )
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+// frm2png includes
+#include "Hash.h"
+#include "InputFiles.h"
+#include "OutputCache.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+    static bool ReadFile( const std::string& filename, std::vector<uint8_t>& content )
+    {
+        std::ifstream stream( filename, std::ios_base::in | std::ios_base::binary );
+        if( !stream.is_open() )
+            return false;
+
+        stream.seekg( 0, std::ios_base::end );
+        content.resize( static_cast<std::size_t>( stream.tellg() ) );
+        stream.seekg( 0, std::ios_base::beg );
+
+        return static_cast<bool>( stream.read( reinterpret_cast<char*>( content.data() ), static_cast<std::streamsize>( content.size() ) ) );
+    }
+
+    static void WriteFile( const std::string& filename, const std::vector<uint8_t>& content )
+    {
+        FileSink sink( filename, content.size() );
+        sink.write( content.data(), content.size() );
+        sink.close();
+    }
+
+    static bool LinkFile( const std::string& from, const std::string& to )
+    {
+#if defined( _WIN32 )
+        return CreateHardLinkA( to.c_str(), from.c_str(), nullptr ) != 0;
+#else
+        return link( from.c_str(), to.c_str() ) == 0;
+#endif
+    }
+
+    // name unique between processes writing to the same cache
+    static std::string TemporaryName( const std::string& filename )
+    {
+        thread_local std::random_device random;
+
+        return filename + ".tmp" + HashToString( ( static_cast<uint64_t>( random() ) << 32 ) | random() );
+    }
+
+    // target is replaced if it exists; another process might have stored identical file in meantime
+    static void WriteFileAtomic( const std::string& filename, const std::vector<uint8_t>& content )
+    {
+        const std::string temporary = TemporaryName( filename );
+
+        WriteFile( temporary, content );
+
+        if( std::rename( temporary.c_str(), filename.c_str() ) != 0 )
+        {
+            std::remove( filename.c_str() );
+
+            if( std::rename( temporary.c_str(), filename.c_str() ) != 0 )
+            {
+                std::remove( temporary.c_str() );
+                throw std::runtime_error( "OutputCache::store() - Can't write cache file: " + filename );
+            }
+        }
+    }
+
+    // cache can be shared with other users; entries naming files outside of output directory are never used
+    static bool IsSafeSuffix( const std::string& suffix )
+    {
+        return suffix.find_first_of( "/\\" ) == std::string::npos && suffix.find( ".." ) == std::string::npos;
+    }
+
+    OutputCache::OutputCache( const std::string& directory ) :
+        _directory( directory )
+    {}
+
+    std::string OutputCache::entry( const std::string& key ) const
+    {
+        // first two characters are used as subdirectory, to keep directories small
+        return _directory + "/" + key.substr( 0, 2 ) + "/" + key;
+    }
+
+    bool OutputCache::restore( const std::string& key, const std::string& prefix, std::vector<std::string>& outputs ) const
+    {
+        const std::string directory = entry( key );
+
+        std::ifstream index( directory + "/index" );
+        if( !index.is_open() )
+            return false;
+
+        std::vector<std::string> suffixes;
+        std::string              suffix;
+
+        while( std::getline( index, suffix ) )
+            suffixes.push_back( suffix );
+
+        if( suffixes.empty() || !std::all_of( suffixes.begin(), suffixes.end(), IsSafeSuffix ) )
+            return false;
+
+        // outputs are removed first, so hardlinks can be created, and files shared with cache are never written into
+        for( std::size_t idx = 0; idx < suffixes.size(); idx++ )
+        {
+            const std::string cached = directory + "/" + std::to_string( idx );
+            const std::string output = prefix + suffixes[idx];
+
+            std::remove( output.c_str() );
+
+            if( !LinkFile( cached, output ) )
+            {
+                std::vector<uint8_t> content;
+                if( !ReadFile( cached, content ) )
+                    return false;
+
+                WriteFile( output, content );
+            }
+
+            outputs.push_back( output );
+        }
+
+        return true;
+    }
+
+    void OutputCache::store( const std::string& key, const std::string& prefix, const std::vector<std::string>& outputs ) const
+    {
+        if( outputs.empty() )
+            return;
+
+        for( const std::string& output : outputs )
+        {
+            if( output.compare( 0, prefix.size(), prefix ) != 0 || !IsSafeSuffix( output.substr( prefix.size() ) ) )
+                return;
+        }
+
+        const std::string directory = entry( key );
+        CreateDirectories( directory );
+
+        std::string index;
+        for( std::size_t idx = 0; idx < outputs.size(); idx++ )
+        {
+            std::vector<uint8_t> content;
+            if( !ReadFile( outputs[idx], content ) )
+                throw std::runtime_error( "OutputCache::store() - Can't read output file: " + outputs[idx] );
+
+            WriteFileAtomic( directory + "/" + std::to_string( idx ), content );
+            index += outputs[idx].substr( prefix.size() ) + "\n";
+        }
+
+        WriteFileAtomic( directory + "/index", std::vector<uint8_t>( index.begin(), index.end() ) );
+    }
+}
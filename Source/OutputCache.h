@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#pragma once
+
+// C++ standard includes
+#include <string>
+#include <vector>
+
+namespace frm2png
+{
+    // content-addressed store of output files, shared between runs, workspaces and machines (via shared filesystem)
+    // entries are directories named after key, with files numbered in order of outputs, and index listing filename suffix of each file
+    // files are written under temporary names and renamed, index goes last, so other processes see only complete entries
+    class OutputCache
+    {
+    protected:
+        std::string _directory;
+
+    public:
+        OutputCache( const std::string& directory );
+
+        // creates prefix + suffix for each cached file, as hardlink if possible, otherwise as copy
+        // returns false if key is not cached
+        bool restore( const std::string& key, const std::string& prefix, std::vector<std::string>& outputs ) const;
+
+        // outputs which don't start with prefix cannot be restored elsewhere; nothing is stored if there are any
+        void store( const std::string& key, const std::string& prefix, const std::vector<std::string>& outputs ) const;
+
+    protected:
+        std::string entry( const std::string& key ) const;
+    };
+}
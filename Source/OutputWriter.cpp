@@ -0,0 +1,643 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// system includes
+#if defined( __linux__ ) && defined( __has_include )
+    #if __has_include( <linux/io_uring.h> )
+        #include <cerrno>
+        #include <fcntl.h>
+        #include <linux/io_uring.h>
+        #include <sys/mman.h>
+        #include <sys/syscall.h>
+        #include <unistd.h>
+
+        // IORING_OP_UNLINKAT is enum value, so headers are checked for flag added in following kernel version
+        #if defined( IORING_FEAT_NATIVE_WORKERS ) && defined( __NR_io_uring_setup )
+            #define FRM2PNG_IO_URING
+        #endif
+    #endif
+#endif
+
+// frm2png includes
+#include "Hash.h"
+#include "OutputWriter.h"
+
+namespace frm2png
+{
+    // number of files submitted to io_uring at once
+    static const std::size_t RingFiles = 64;
+
+#if defined( FRM2PNG_IO_URING )
+
+    // minimal io_uring wrapper, using raw system calls
+    // submission queue entries are used in order, so array of indexes is filled once
+    class AsyncFileWriter::Ring
+    {
+    protected:
+        int         _fd = -1;
+        void*       _sqRing = MAP_FAILED;
+        void*       _cqRing = MAP_FAILED;
+        std::size_t _sqRingSize = 0;
+        std::size_t _cqRingSize = 0;
+
+        io_uring_sqe* _sqes     = static_cast<io_uring_sqe*>( MAP_FAILED );
+        std::size_t   _sqesSize = 0;
+
+        unsigned*     _sqHead  = nullptr;
+        unsigned*     _sqTail  = nullptr;
+        unsigned      _sqMask  = 0;
+        unsigned      _sqCount = 0;
+        unsigned*     _cqHead  = nullptr;
+        unsigned*     _cqTail  = nullptr;
+        unsigned      _cqMask  = 0;
+        io_uring_cqe* _cqes    = nullptr;
+
+        // entries added since last io_uring_enter()
+        unsigned _unsubmitted = 0;
+
+    public:
+        // throws if io_uring is not available, or doesn't support required operations
+        Ring( unsigned entries )
+        {
+            io_uring_params params;
+            std::memset( &params, 0, sizeof( params ) );
+
+            _fd = static_cast<int>( syscall( __NR_io_uring_setup, entries, &params ) );
+            if( _fd < 0 )
+                throw std::runtime_error( "Ring() - io_uring_setup failed: " + std::string( std::strerror( errno ) ) );
+
+            _sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+            _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+            _sqesSize   = params.sq_entries * sizeof( io_uring_sqe );
+
+            if( params.features & IORING_FEAT_SINGLE_MMAP )
+                _sqRingSize = _cqRingSize = std::max( _sqRingSize, _cqRingSize );
+
+            _sqRing = mmap( nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING );
+            if( _sqRing != MAP_FAILED )
+            {
+                if( params.features & IORING_FEAT_SINGLE_MMAP )
+                    _cqRing = _sqRing;
+                else
+                    _cqRing = mmap( nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING );
+            }
+
+            if( _cqRing != MAP_FAILED )
+                _sqes = static_cast<io_uring_sqe*>( mmap( nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES ) );
+
+            if( _sqes == MAP_FAILED )
+            {
+                release();
+                throw std::runtime_error( "Ring() - Can't map io_uring queues" );
+            }
+
+            uint8_t* sq = static_cast<uint8_t*>( _sqRing );
+            uint8_t* cq = static_cast<uint8_t*>( _cqRing );
+
+            _sqHead  = reinterpret_cast<unsigned*>( sq + params.sq_off.head );
+            _sqTail  = reinterpret_cast<unsigned*>( sq + params.sq_off.tail );
+            _sqMask  = *reinterpret_cast<unsigned*>( sq + params.sq_off.ring_mask );
+            _sqCount = params.sq_entries;
+            _cqHead  = reinterpret_cast<unsigned*>( cq + params.cq_off.head );
+            _cqTail  = reinterpret_cast<unsigned*>( cq + params.cq_off.tail );
+            _cqMask  = *reinterpret_cast<unsigned*>( cq + params.cq_off.ring_mask );
+            _cqes    = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+
+            unsigned* array = reinterpret_cast<unsigned*>( sq + params.sq_off.array );
+            for( unsigned idx = 0; idx < _sqCount; idx++ )
+                array[idx] = idx;
+
+            if( !supported() )
+            {
+                release();
+                throw std::runtime_error( "Ring() - io_uring doesn't support file operations" );
+            }
+        }
+
+        ~Ring()
+        {
+            release();
+        }
+
+        // returns cleared entry, or nullptr if queue is full
+        io_uring_sqe* next()
+        {
+            const unsigned tail = *_sqTail;
+            if( tail - __atomic_load_n( _sqHead, __ATOMIC_ACQUIRE ) >= _sqCount )
+                return nullptr;
+
+            io_uring_sqe* sqe = &_sqes[tail & _sqMask];
+            std::memset( sqe, 0, sizeof( io_uring_sqe ) );
+
+            __atomic_store_n( _sqTail, tail + 1, __ATOMIC_RELEASE );
+            _unsubmitted++;
+
+            return sqe;
+        }
+
+        // submits new entries, and waits until given number of operations is complete
+        void enter( unsigned wait )
+        {
+            while( true )
+            {
+                const long result = syscall( __NR_io_uring_enter, _fd, _unsubmitted, wait, wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0 );
+
+                if( result >= 0 )
+                {
+                    _unsubmitted -= static_cast<unsigned>( result );
+                    if( !_unsubmitted || !wait )
+                        return;
+                }
+                else if( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+                    throw std::runtime_error( "Ring::enter() - io_uring_enter failed: " + std::string( std::strerror( errno ) ) );
+            }
+        }
+
+        // returns false if there are no completed operations
+        bool complete( uint64_t& userData, int32_t& result )
+        {
+            const unsigned head = *_cqHead;
+            if( head == __atomic_load_n( _cqTail, __ATOMIC_ACQUIRE ) )
+                return false;
+
+            const io_uring_cqe& cqe = _cqes[head & _cqMask];
+            userData                = cqe.user_data;
+            result                  = cqe.res;
+
+            __atomic_store_n( _cqHead, head + 1, __ATOMIC_RELEASE );
+
+            return true;
+        }
+
+    protected:
+        bool supported()
+        {
+            std::vector<uint8_t> buffer( sizeof( io_uring_probe ) + 256 * sizeof( io_uring_probe_op ), 0 );
+            io_uring_probe*      probe = reinterpret_cast<io_uring_probe*>( buffer.data() );
+
+            if( syscall( __NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe, 256 ) < 0 )
+                return false;
+
+            for( uint8_t op : { IORING_OP_UNLINKAT, IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE } )
+            {
+                if( op > probe->last_op || !( probe->ops[op].flags & IO_URING_OP_SUPPORTED ) )
+                    return false;
+            }
+
+            return true;
+        }
+
+        void release()
+        {
+            if( _sqes != MAP_FAILED )
+                munmap( _sqes, _sqesSize );
+            if( _cqRing != MAP_FAILED && _cqRing != _sqRing )
+                munmap( _cqRing, _cqRingSize );
+            if( _sqRing != MAP_FAILED )
+                munmap( _sqRing, _sqRingSize );
+            if( _fd >= 0 )
+                close( _fd );
+
+            _sqes   = static_cast<io_uring_sqe*>( MAP_FAILED );
+            _cqRing = _sqRing = MAP_FAILED;
+            _fd     = -1;
+        }
+    };
+
+#else
+
+    class AsyncFileWriter::Ring
+    {
+    public:
+        Ring( unsigned )
+        {
+            throw std::runtime_error( "Ring() - io_uring not available" );
+        }
+    };
+
+#endif
+
+    // passes buffer to writer when closed
+    class AsyncFileSink : public MemorySink
+    {
+    protected:
+        AsyncFileWriter& _writer;
+        std::string      _filename;
+
+    public:
+        AsyncFileSink( AsyncFileWriter& writer, const std::string& filename, std::size_t reserve ) :
+            MemorySink( reserve ),
+            _writer( writer ),
+            _filename( filename )
+        {}
+
+        virtual void close() override
+        {
+            if( _closed )
+                return;
+
+            MemorySink::close();
+            _writer.add( _filename, release() );
+        }
+    };
+
+    AsyncFileWriter::Writer::Writer( std::size_t depth ) :
+        Queue( depth )
+    {}
+
+    AsyncFileWriter::AsyncFileWriter( std::size_t writers, std::size_t depth )
+    {
+        // each file needs up to two entries at once (unlink + open)
+        try
+        {
+            _ring.reset( new Ring( static_cast<unsigned>( RingFiles * 2 ) ) );
+            writers = 1;
+        }
+        catch( std::exception& )
+        {
+            if( !writers )
+                writers = 1;
+        }
+
+        for( std::size_t idx = 0; idx < writers; idx++ )
+            _writers.emplace_back( new Writer( depth ) );
+
+        for( std::unique_ptr<Writer>& writer : _writers )
+        {
+            Writer* ptr = writer.get();
+
+            if( _ring )
+                writer->Thread = std::thread( [this, ptr]() { submit( *ptr ); } );
+            else
+                writer->Thread = std::thread( [this, ptr]() { write( *ptr ); } );
+        }
+    }
+
+    AsyncFileWriter::~AsyncFileWriter()
+    {
+        for( std::unique_ptr<Writer>& writer : _writers )
+        {
+            writer->Queue.close();
+
+            if( writer->Thread.joinable() )
+                writer->Thread.join();
+        }
+    }
+
+    std::unique_ptr<Sink> AsyncFileWriter::create( const std::string& filename, std::size_t reserve /* = 0 */ )
+    {
+        return std::unique_ptr<Sink>( new AsyncFileSink( *this, filename, reserve ) );
+    }
+
+    void AsyncFileWriter::add( const std::string& filename, std::vector<uint8_t>&& content )
+    {
+        Writer& writer = *_writers[HashString( filename ) % _writers.size()];
+
+        if( !writer.Queue.push( Request { filename, std::move( content ) } ) )
+            throw std::runtime_error( "AsyncFileWriter::add() - Writer already finished: " + filename );
+    }
+
+    void AsyncFileWriter::finish()
+    {
+        for( std::unique_ptr<Writer>& writer : _writers )
+        {
+            writer->Queue.close();
+
+            if( writer->Thread.joinable() )
+                writer->Thread.join();
+        }
+
+        std::lock_guard<std::mutex> lock( _lock );
+        if( _error )
+            std::rethrow_exception( _error );
+    }
+
+    const char* AsyncFileWriter::backend() const
+    {
+        return _ring ? "io_uring" : "threads";
+    }
+
+    void AsyncFileWriter::fail( std::exception_ptr error )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+        if( !_error )
+            _error = error;
+    }
+
+    void AsyncFileWriter::write( Writer& writer )
+    {
+        Request request;
+
+        while( writer.Queue.pop( request ) )
+        {
+            replace( request );
+            request = Request();
+        }
+    }
+
+    void AsyncFileWriter::replace( const Request& request )
+    {
+        try
+        {
+            ReplaceFile( request.Filename, request.Content.data(), request.Content.size() );
+        }
+        catch( ... )
+        {
+            fail( std::current_exception() );
+        }
+    }
+
+#if defined( FRM2PNG_IO_URING )
+
+    void AsyncFileWriter::submit( Writer& writer )
+    {
+        // each file goes through same steps as in ReplaceFile(); unlink and open are submitted together
+        enum Step : uint8_t
+        {
+            Unlink,
+            Open,
+            Write,
+            Close
+        };
+
+        struct Slot
+        {
+            Request     File;
+            int         Fd      = -1;
+            std::size_t Written = 0;
+            unsigned    Pending = 0; // operations submitted, but not completed yet
+            bool        Used    = false;
+            bool        Failed  = false;
+        };
+
+        std::vector<Slot>   slots( RingFiles );
+        std::deque<Request> deferred;
+        std::size_t         active = 0;
+
+        auto entry = [this, &slots]( std::size_t slot, Step step ) {
+            io_uring_sqe* sqe = _ring->next();
+            if( !sqe )
+                throw std::runtime_error( "AsyncFileWriter::submit() - io_uring queue is full" );
+
+            sqe->user_data = ( static_cast<uint64_t>( slot ) << 8 ) | step;
+            slots[slot].Pending++;
+
+            return sqe;
+        };
+
+        auto queueWrite = [&slots, &entry]( std::size_t idx ) {
+            Slot&             slot   = slots[idx];
+            const std::size_t length = std::min<std::size_t>( slot.File.Content.size() - slot.Written, 1u << 30 );
+
+            io_uring_sqe* sqe = entry( idx, Write );
+            sqe->opcode       = IORING_OP_WRITE;
+            sqe->fd           = slot.Fd;
+            sqe->addr         = reinterpret_cast<uint64_t>( slot.File.Content.data() + slot.Written );
+            sqe->len          = static_cast<uint32_t>( length );
+            sqe->off          = slot.Written;
+        };
+
+        auto queueClose = [&slots, &entry]( std::size_t idx ) {
+            io_uring_sqe* sqe = entry( idx, Close );
+            sqe->opcode       = IORING_OP_CLOSE;
+            sqe->fd           = slots[idx].Fd;
+        };
+
+        auto start = [&slots, &active, &entry]( Request&& request ) {
+            const std::size_t idx  = static_cast<std::size_t>( std::find_if( slots.begin(), slots.end(), []( const Slot& slot ) { return !slot.Used; } ) - slots.begin() );
+            Slot&             slot = slots[idx];
+
+            slot      = Slot();
+            slot.File = std::move( request );
+            slot.Used = true;
+            active++;
+
+            // existing file is replaced rather than overwritten, see ReplaceFile(); open runs even if there's nothing to remove
+            io_uring_sqe* sqe = entry( idx, Unlink );
+            sqe->opcode       = IORING_OP_UNLINKAT;
+            sqe->fd           = AT_FDCWD;
+            sqe->addr         = reinterpret_cast<uint64_t>( slot.File.Filename.c_str() );
+            sqe->flags        = IOSQE_IO_HARDLINK;
+
+            sqe             = entry( idx, Open );
+            sqe->opcode     = IORING_OP_OPENAT;
+            sqe->fd         = AT_FDCWD;
+            sqe->addr       = reinterpret_cast<uint64_t>( slot.File.Filename.c_str() );
+            sqe->len        = 0666;
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        };
+
+        auto done = [&slots, &active]( std::size_t idx ) {
+            slots[idx] = Slot();
+            active--;
+        };
+
+        auto writing = [&slots]( const std::string& filename ) {
+            return std::any_of( slots.begin(), slots.end(), [&filename]( const Slot& slot ) { return slot.Used && slot.File.Filename == filename; } );
+        };
+
+        // files with same name as file still being written wait for their turn, so they're never written concurrently
+        auto busy = [&deferred, &writing]( const std::string& filename ) {
+            return writing( filename ) || std::any_of( deferred.begin(), deferred.end(), [&filename]( const Request& request ) { return request.Filename == filename; } );
+        };
+
+        try
+        {
+            while( true )
+            {
+                // takes new files until all slots are used; waits for files only when there's nothing else to do
+                while( active < slots.size() )
+                {
+                    if( !deferred.empty() && !writing( deferred.front().Filename ) )
+                    {
+                        start( std::move( deferred.front() ) );
+                        deferred.pop_front();
+                        continue;
+                    }
+
+                    Request request;
+
+                    if( !active && deferred.empty() )
+                    {
+                        if( !writer.Queue.pop( request ) )
+                            return;
+                    }
+                    else if( !writer.Queue.tryPop( request ) )
+                        break;
+
+                    if( busy( request.Filename ) )
+                        deferred.push_back( std::move( request ) );
+                    else
+                        start( std::move( request ) );
+                }
+
+                _ring->enter( 1 );
+
+                uint64_t userData;
+                int32_t  result;
+
+                while( _ring->complete( userData, result ) )
+                {
+                    const std::size_t idx  = static_cast<std::size_t>( userData >> 8 );
+                    Slot&             slot = slots[idx];
+
+                    slot.Pending--;
+
+                    switch( static_cast<Step>( userData & 0xFF ) )
+                    {
+                        case Unlink:
+                            break;
+
+                        case Open:
+                            if( result < 0 )
+                            {
+                                fail( std::make_exception_ptr( std::runtime_error( "AsyncFileWriter::submit() - Can't open output file: " + slot.File.Filename ) ) );
+                                done( idx );
+                            }
+                            else
+                            {
+                                slot.Fd = result;
+
+                                if( slot.File.Content.empty() )
+                                    queueClose( idx );
+                                else
+                                    queueWrite( idx );
+                            }
+                            break;
+
+                        case Write:
+                            if( result <= 0 )
+                            {
+                                slot.Failed = true;
+                                queueClose( idx );
+                                break;
+                            }
+
+                            slot.Written += static_cast<std::size_t>( result );
+
+                            if( slot.Written < slot.File.Content.size() )
+                                queueWrite( idx );
+                            else
+                                queueClose( idx );
+                            break;
+
+                        case Close:
+                            if( result < 0 || slot.Failed )
+                                fail( std::make_exception_ptr( std::runtime_error( "AsyncFileWriter::submit() - Can't write output file: " + slot.File.Filename ) ) );
+
+                            done( idx );
+                            break;
+                    }
+                }
+            }
+        }
+        catch( ... )
+        {
+            fail( std::current_exception() );
+        }
+
+        // ring can't be used anymore; operations already submitted must complete before their buffers are released,
+        // and descriptors opened so far are closed, as files are written again
+        auto settle = [&active]( Slot& slot ) {
+            if( slot.Fd >= 0 )
+                close( slot.Fd );
+
+            slot.Fd = -1;
+            active--;
+        };
+
+        for( Slot& slot : slots )
+        {
+            if( slot.Used && !slot.Pending )
+                settle( slot );
+        }
+
+        try
+        {
+            while( active )
+            {
+                _ring->enter( 1 );
+
+                uint64_t userData;
+                int32_t  result;
+
+                while( _ring->complete( userData, result ) )
+                {
+                    Slot&      slot = slots[static_cast<std::size_t>( userData >> 8 )];
+                    const Step step = static_cast<Step>( userData & 0xFF );
+
+                    if( step == Open && result >= 0 )
+                        slot.Fd = result;
+                    else if( step == Close )
+                    {
+                        // file is complete, unless last write failed
+                        slot.Used = result < 0 || slot.Failed;
+                        slot.Fd   = -1;
+                    }
+
+                    if( !--slot.Pending )
+                        settle( slot );
+                }
+            }
+        }
+        catch( ... )
+        {
+            fail( std::current_exception() );
+        }
+
+        // unfinished files are written with blocking calls, before files with same name waiting for them; so are files added later, so sinks never fail
+        for( Slot& slot : slots )
+        {
+            if( slot.Used )
+                replace( slot.File );
+        }
+
+        for( const Request& request : deferred )
+            replace( request );
+
+        write( writer );
+    }
+
+#else
+
+    void AsyncFileWriter::submit( Writer& writer )
+    {
+        write( writer );
+    }
+
+#endif
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// frm2png includes
+#include "BoundedQueue.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+    // writes closed files on separate threads, so threads encoding outputs don't wait for storage
+    // on Linux, single writer submits files through io_uring, with many files being created at once; if io_uring is not available,
+    // files are written by several threads using blocking calls; if io_uring fails while in use, its writer switches to blocking calls
+    // each file goes to writer picked by its name, so file written again under same name always ends up with latest content
+    // sinks wait when writer queue is full, which limits memory used by files waiting to be written
+    class AsyncFileWriter : public SinkFactory
+    {
+    protected:
+        struct Request
+        {
+            std::string          Filename;
+            std::vector<uint8_t> Content;
+        };
+
+        struct Writer
+        {
+            BoundedQueue<Request> Queue;
+            std::thread           Thread;
+
+            Writer( std::size_t depth );
+        };
+
+        // io_uring instance; not set when blocking writes are used
+        class Ring;
+
+        std::vector<std::unique_ptr<Writer>> _writers;
+        std::unique_ptr<Ring>                _ring;
+
+        // first write error; rethrown by finish()
+        std::mutex         _lock;
+        std::exception_ptr _error;
+
+    public:
+        AsyncFileWriter( std::size_t writers, std::size_t depth );
+
+        // files queued so far are still written, but errors are ignored; use finish() to see them
+        virtual ~AsyncFileWriter();
+
+        AsyncFileWriter( const AsyncFileWriter& ) = delete;
+        AsyncFileWriter& operator=( const AsyncFileWriter& ) = delete;
+
+        virtual std::unique_ptr<Sink> create( const std::string& filename, std::size_t reserve = 0 ) override;
+
+        // called by created sinks when closed; waits while writer queue is full
+        void add( const std::string& filename, std::vector<uint8_t>&& content );
+
+        // waits until all queued files are written; rethrows first error
+        // no more files can be added afterwards
+        void finish();
+
+        // "io_uring" or "threads"
+        const char* backend() const;
+
+    protected:
+        void fail( std::exception_ptr error );
+
+        // writer thread loops; blocking writes, or io_uring
+        void write( Writer& writer );
+        void submit( Writer& writer );
+
+        // blocking write of single file; errors are passed to fail()
+        void replace( const Request& request );
+    };
+}
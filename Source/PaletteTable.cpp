@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// frm2png includes
+#include "PaletteTable.h"
+
+namespace frm2png
+{
+    PaletteTable::PaletteTable( const Falltergeist::Format::Pal::File& pal, uint8_t multiplier ) :
+        Multiplier( multiplier )
+    {
+        Falltergeist::Format::Pal::File multiplied = pal;
+        multiplied.RGBMultiplier( multiplier );
+
+        for( std::size_t idx = 0; idx < 256; idx++ )
+        {
+            const Falltergeist::Format::Pal::Color& color = multiplied.Get( idx );
+
+            Colors[idx][0] = color.R;
+            Colors[idx][1] = color.G;
+            Colors[idx][2] = color.B;
+            Colors[idx][3] = color.A;
+        }
+    }
+
+    std::shared_ptr<const PaletteTable> PaletteRegistry::get( const std::string& source, uint8_t multiplier, const std::function<Falltergeist::Format::Pal::File()>& load )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        std::shared_ptr<const PaletteTable>& table = _tables[source + "\n" + std::to_string( multiplier )];
+        if( !table )
+            table = std::make_shared<const PaletteTable>( load(), multiplier );
+
+        return table;
+    }
+}
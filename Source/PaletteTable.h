@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// falltergeist includes
+#include "Format/Pal/File.h"
+
+namespace frm2png
+{
+    // colors of .pal file with multiplier applied, as RGBA ready to be copied into images
+    // immutable once created, so single table can be shared by all files (and threads) using same palette
+    struct PaletteTable
+    {
+        // alpha is zero for transparent color
+        uint8_t Colors[256][4];
+        uint8_t Multiplier;
+
+        // throws if multiplier is invalid for given palette
+        PaletteTable( const Falltergeist::Format::Pal::File& pal, uint8_t multiplier );
+    };
+
+    // colors starting with this index are animated by game engine; see Pal::File::PostProcess()
+    const uint8_t PaletteFirstMagicColor = 229;
+
+    // creates table for each (palette, multiplier) pair on first use, and keeps it for later; safe to use by multiple threads
+    class PaletteRegistry
+    {
+    protected:
+        std::mutex                                                 _lock;
+        std::map<std::string, std::shared_ptr<const PaletteTable>> _tables;
+
+    public:
+        // source identifies palette content, e.g. embedded palette name, or filename with its modification time
+        // load() is called only if table doesn't exist yet
+        std::shared_ptr<const PaletteTable> get( const std::string& source, uint8_t multiplier, const std::function<Falltergeist::Format::Pal::File()>& load );
+    };
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "PngEncoder.h"
+#include "PngFilter.h"
+#include "PngImage.h"
+#include "PngPalette.h"
+#include "Sink.h"
+#include "ThreadPool.h"
+
+// Third party includes
+#include <png.h>
+#include <zlib.h>
+
+namespace frm2png
+{
+    static const char* StrategyName( int strategy )
+    {
+        switch( strategy )
+        {
+            case Z_DEFAULT_STRATEGY:
+                return "default";
+            case Z_FILTERED:
+                return "filtered";
+            case Z_HUFFMAN_ONLY:
+                return "huffman";
+            case Z_RLE:
+                return "rle";
+            case Z_FIXED:
+                return "fixed";
+        }
+
+        return "?";
+    }
+
+    std::string PngEncoderSettingsToString( const PngEncoderSettings& settings )
+    {
+        return std::string( settings.Indexed ? "indexed" : "rgba" ) +
+               " filter:" + PngFilterModeToString( settings.Filter ) +
+               " level:" + std::to_string( settings.Level ) +
+               " strategy:" + StrategyName( settings.Strategy ) +
+               " window:" + std::to_string( settings.WindowBits );
+    }
+
+    std::vector<PngEncoderSettings> PngEncoderCandidates( const PngEncoderSettings& base, unsigned optimize )
+    {
+        if( !optimize )
+            return { base };
+
+        // most useful first; pixel art usually compresses best without filtering
+        // clang-format off
+        static const std::vector<PngEncoderSettings> candidates =
+        {
+            // indexed  filter                   level  strategy            window
+            {  true,    PngFilterMode::None,     9,     Z_DEFAULT_STRATEGY, 15 },
+            {  false,   PngFilterMode::Sum,      9,     Z_FILTERED,         15 },
+            {  false,   PngFilterMode::None,     9,     Z_DEFAULT_STRATEGY, 15 },
+            {  true,    PngFilterMode::Sum,      9,     Z_DEFAULT_STRATEGY, 15 },
+            {  true,    PngFilterMode::None,     9,     Z_RLE,              15 },
+            {  true,    PngFilterMode::Brute,    9,     Z_DEFAULT_STRATEGY, 15 },
+            {  false,   PngFilterMode::Brute,    9,     Z_FILTERED,         15 },
+            {  true,    PngFilterMode::None,     9,     Z_FILTERED,         15 },
+            {  false,   PngFilterMode::Sum,      9,     Z_DEFAULT_STRATEGY, 15 },
+            {  false,   PngFilterMode::None,     9,     Z_RLE,              15 },
+            {  true,    PngFilterMode::Sum,      9,     Z_FILTERED,         15 },
+            {  true,    PngFilterMode::Brute,    9,     Z_RLE,              15 },
+            {  false,   PngFilterMode::Brute,    9,     Z_DEFAULT_STRATEGY, 15 },
+            {  true,    PngFilterMode::None,     9,     Z_DEFAULT_STRATEGY, 12 },
+            {  false,   PngFilterMode::Sum,      9,     Z_FILTERED,         12 },
+            {  true,    PngFilterMode::None,     9,     Z_HUFFMAN_ONLY,     15 }
+        };
+        // clang-format on
+
+        return std::vector<PngEncoderSettings>( candidates.begin(), candidates.begin() + std::min<std::size_t>( optimize, candidates.size() ) );
+    }
+
+    std::vector<uint8_t> PngCompress( png_bytepp rows, uint32_t width, uint32_t height, std::size_t bpp, const PngEncoderSettings& settings )
+    {
+        const std::size_t rowSize = width * bpp;
+        PngFilter         filter( settings.Filter, rowSize, bpp, settings.Level );
+
+        z_stream stream;
+        std::memset( &stream, 0, sizeof( stream ) );
+
+        if( deflateInit2( &stream, settings.Level, Z_DEFLATED, settings.WindowBits, 8, settings.Strategy ) != Z_OK )
+            throw std::runtime_error( "PngCompress() - Could not initialize zlib" );
+
+        std::vector<uint8_t> result( deflateBound( &stream, static_cast<uLong>( ( rowSize + 1 ) * height ) ) );
+
+        stream.next_out  = result.data();
+        stream.avail_out = static_cast<uInt>( result.size() );
+
+        int status = Z_OK;
+        for( uint32_t y = 0; y < height && status == Z_OK; y++ )
+        {
+            const std::vector<uint8_t>& filtered = filter.filter( rows[y], y ? rows[y - 1] : nullptr );
+
+            stream.next_in  = const_cast<Bytef*>( filtered.data() );
+            stream.avail_in = static_cast<uInt>( filtered.size() );
+
+            status = deflate( &stream, y + 1 < height ? Z_NO_FLUSH : Z_FINISH );
+        }
+
+        result.resize( stream.total_out );
+        deflateEnd( &stream );
+
+        if( status != Z_STREAM_END )
+            throw std::runtime_error( "PngCompress() - Error during compression (" + std::to_string( status ) + ")" );
+
+        return result;
+    }
+
+    std::vector<uint8_t> PngCompress( const PngImage& image, const PngEncoderSettings& settings, const PngPalette* palette )
+    {
+        if( !settings.Indexed )
+            return PngCompress( image.rows(), image.width(), image.height(), 4, settings );
+
+        std::vector<uint8_t> indexes;
+        if( !palette || !palette->convert( image, indexes ) )
+            return {};
+
+        std::vector<png_bytep> rows( image.height() );
+        for( uint32_t y = 0; y < image.height(); y++ )
+        {
+            rows[y] = &indexes[static_cast<std::size_t>( image.width() ) * y];
+        }
+
+        return PngCompress( rows.data(), image.width(), image.height(), 1, settings );
+    }
+
+    PngEncoderSettings PngEncode( Sink& sink, const PngImage& image, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette /* = nullptr */, ThreadPool* pool /* = nullptr */ )
+    {
+        if( candidates.empty() )
+            throw std::runtime_error( "PngEncode() - No encoder settings" );
+
+        // create palette only if it's going to be used
+        PngPalette imagePalette;
+        if( !palette && std::any_of( candidates.begin(), candidates.end(), []( const PngEncoderSettings& settings ) { return settings.Indexed; } ) )
+        {
+            if( PngPalette::fromImage( image, imagePalette ) )
+                palette = &imagePalette;
+        }
+
+        std::vector<std::future<std::vector<uint8_t>>> results;
+        for( const auto& settings : candidates )
+        {
+            auto compress = [&image, settings, palette]() { return PngCompress( image, settings, palette ); };
+
+            if( pool )
+                results.push_back( pool->submit( compress ) );
+            else
+            {
+                std::promise<std::vector<uint8_t>> result;
+                result.set_value( compress() );
+                results.push_back( result.get_future() );
+            }
+        }
+
+        // tasks are using image and palette; all of them must finish before anything is thrown
+        if( pool )
+        {
+            for( auto& result : results )
+                pool->ready( result );
+        }
+
+        std::size_t          best = candidates.size();
+        std::vector<uint8_t> data;
+
+        for( std::size_t idx = 0; idx < candidates.size(); idx++ )
+        {
+            std::vector<uint8_t> result = results[idx].get();
+
+            if( !result.empty() && ( best == candidates.size() || result.size() < data.size() ) )
+            {
+                best = idx;
+                data = std::move( result );
+            }
+        }
+
+        if( best == candidates.size() )
+            throw std::runtime_error( "PngEncode() - Image cannot be encoded with given settings" );
+
+        PngWriteSignature( sink );
+        PngWriteHeader( sink, image.width(), image.height(), candidates[best].Indexed ? palette : nullptr );
+        PngWriteChunk( sink, "IDAT", data );
+        PngWriteChunk( sink, "IEND", nullptr, 0 );
+
+        sink.close();
+
+        return candidates[best];
+    }
+
+    void PngWriteSignature( Sink& sink )
+    {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+        sink.write( signature, sizeof( signature ) );
+    }
+
+    void PngWriteHeader( Sink& sink, uint32_t width, uint32_t height, const PngPalette* palette )
+    {
+        std::vector<uint8_t> ihdr;
+
+        PngPut32( ihdr, width );
+        PngPut32( ihdr, height );
+        PngPut8( ihdr, 8 ); // bit depth
+        PngPut8( ihdr, palette ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGB_ALPHA );
+        PngPut8( ihdr, PNG_COMPRESSION_TYPE_DEFAULT );
+        PngPut8( ihdr, PNG_FILTER_TYPE_DEFAULT );
+        PngPut8( ihdr, PNG_INTERLACE_NONE );
+
+        PngWriteChunk( sink, "IHDR", ihdr );
+
+        if( palette )
+        {
+            PngWriteChunk( sink, "PLTE", palette->plte() );
+
+            std::vector<uint8_t> trns = palette->trns();
+            if( !trns.empty() )
+                PngWriteChunk( sink, "tRNS", trns );
+        }
+    }
+
+    void PngWriteChunk( Sink& sink, const char* type, const uint8_t* data, std::size_t size )
+    {
+        std::vector<uint8_t> header;
+        PngPut32( header, static_cast<uint32_t>( size ) );
+        header.insert( header.end(), type, type + 4 );
+
+        uLong crc = crc32( 0, reinterpret_cast<const Bytef*>( type ), 4 );
+        if( size )
+            crc = crc32( crc, data, static_cast<uInt>( size ) );
+
+        std::vector<uint8_t> footer;
+        PngPut32( footer, static_cast<uint32_t>( crc ) );
+
+        sink.write( header.data(), header.size() );
+        if( size )
+            sink.write( data, size );
+        sink.write( footer.data(), footer.size() );
+    }
+
+    void PngWriteChunk( Sink& sink, const char* type, const std::vector<uint8_t>& data )
+    {
+        PngWriteChunk( sink, type, data.data(), data.size() );
+    }
+
+    void PngPut8( std::vector<uint8_t>& data, uint8_t value )
+    {
+        data.push_back( value );
+    }
+
+    void PngPut16( std::vector<uint8_t>& data, uint16_t value )
+    {
+        data.push_back( static_cast<uint8_t>( value >> 8 ) );
+        data.push_back( static_cast<uint8_t>( value ) );
+    }
+
+    void PngPut32( std::vector<uint8_t>& data, uint32_t value )
+    {
+        data.push_back( static_cast<uint8_t>( value >> 24 ) );
+        data.push_back( static_cast<uint8_t>( value >> 16 ) );
+        data.push_back( static_cast<uint8_t>( value >> 8 ) );
+        data.push_back( static_cast<uint8_t>( value ) );
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "PngFilter.h"
+#include "PngImage.h"
+#include "PngPalette.h"
+#include "Sink.h"
+#include "ThreadPool.h"
+
+// Third party includes
+#include <png.h>
+#include <zlib.h>
+
+namespace frm2png
+{
+    // low-level (A)PNG encoding, used where libpng's sequential API gets in the way
+
+    // defaults match libpng defaults for filtered images
+    struct PngEncoderSettings
+    {
+        bool          Indexed    = false; // requires palette
+        PngFilterMode Filter     = PngFilterMode::Sum;
+        int           Level      = Z_DEFAULT_COMPRESSION;
+        int           Strategy   = Z_FILTERED;
+        int           WindowBits = 15;
+    };
+
+    std::string PngEncoderSettingsToString( const PngEncoderSettings& settings );
+
+    // settings tried when optimizing output
+    // returns only base settings if optimize is 0, otherwise first `optimize` entries of built-in candidates list (most useful first)
+    std::vector<PngEncoderSettings> PngEncoderCandidates( const PngEncoderSettings& base, unsigned optimize );
+
+    // filters and deflates image; result is ready to be stored in IDAT/fdAT chunk(s)
+    // filtered rows are passed to zlib one by one, filtered image is never stored in memory
+    std::vector<uint8_t> PngCompress( png_bytepp rows, uint32_t width, uint32_t height, std::size_t bpp, const PngEncoderSettings& settings );
+    // converts image to indexes first if settings requires it; returns empty result if palette is missing or doesn't contain all image colors
+    std::vector<uint8_t> PngCompress( const PngImage& image, const PngEncoderSettings& settings, const PngPalette* palette );
+
+    // writes complete (non-animated) png and closes sink
+    // image is compressed with each candidate settings (in parallel, if pool is given) and smallest result is written; returns settings used
+    // if palette is not given, it's created from image colors when needed
+    PngEncoderSettings PngEncode( Sink& sink, const PngImage& image, const std::vector<PngEncoderSettings>& candidates, const PngPalette* palette = nullptr, ThreadPool* pool = nullptr );
+
+    void PngWriteSignature( Sink& sink );
+    // IHDR chunk, followed by PLTE/tRNS chunks for indexed images
+    void PngWriteHeader( Sink& sink, uint32_t width, uint32_t height, const PngPalette* palette );
+    void PngWriteChunk( Sink& sink, const char* type, const uint8_t* data, std::size_t size );
+    void PngWriteChunk( Sink& sink, const char* type, const std::vector<uint8_t>& data );
+
+    // helpers for building chunks data; all values are big-endian
+    void PngPut8( std::vector<uint8_t>& data, uint8_t value );
+    void PngPut16( std::vector<uint8_t>& data, uint16_t value );
+    void PngPut32( std::vector<uint8_t>& data, uint32_t value );
+}
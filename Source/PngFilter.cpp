@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "PngFilter.h"
+
+// Third party includes
+#include <zlib.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#    define FRM2PNG_SSE2
+#    include <emmintrin.h>
+#endif
+
+namespace frm2png
+{
+    static const std::string FilterModeName[] = { "none", "sum", "paletted", "brute" };
+
+    bool PngFilterModeFromString( const std::string& name, PngFilterMode& mode )
+    {
+        for( uint8_t idx = 0; idx < 4; idx++ )
+        {
+            if( FilterModeName[idx] == name )
+            {
+                mode = static_cast<PngFilterMode>( idx );
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const std::string& PngFilterModeToString( PngFilterMode mode )
+    {
+        return FilterModeName[static_cast<uint8_t>( mode )];
+    }
+
+    //
+    // kernels
+    //
+    // all filters are computed from unfiltered data only, so every byte after first pixel can be processed independently
+    // vectorized loops handle [bpp, rowSize) in 16 bytes steps, scalar loops handle first pixel and remaining tail
+    //
+
+    static inline uint8_t Paeth( uint8_t a, uint8_t b, uint8_t c )
+    {
+        const int p  = a + b - c;
+        const int pa = std::abs( p - a );
+        const int pb = std::abs( p - b );
+        const int pc = std::abs( p - c );
+
+        if( pa <= pb && pa <= pc )
+            return a;
+        else if( pb <= pc )
+            return b;
+
+        return c;
+    }
+
+#ifdef FRM2PNG_SSE2
+    static inline __m128i Load( const uint8_t* data )
+    {
+        return _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+    }
+
+    static inline void Store( uint8_t* data, __m128i value )
+    {
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( data ), value );
+    }
+
+    static inline __m128i Abs16( __m128i value )
+    {
+        return _mm_max_epi16( value, _mm_sub_epi16( _mm_setzero_si128(), value ) );
+    }
+
+    // paeth predictor for 8 values expanded to 16bit
+    static inline __m128i Paeth16( __m128i a, __m128i b, __m128i c )
+    {
+        const __m128i pa = Abs16( _mm_sub_epi16( b, c ) );
+        const __m128i pb = Abs16( _mm_sub_epi16( a, c ) );
+        const __m128i pc = Abs16( _mm_sub_epi16( _mm_add_epi16( a, b ), _mm_add_epi16( c, c ) ) );
+
+        // pa <= pb && pa <= pc
+        const __m128i useA = _mm_andnot_si128( _mm_or_si128( _mm_cmpgt_epi16( pa, pb ), _mm_cmpgt_epi16( pa, pc ) ), _mm_set1_epi16( -1 ) );
+        // pb <= pc
+        const __m128i useB = _mm_andnot_si128( _mm_cmpgt_epi16( pb, pc ), _mm_set1_epi16( -1 ) );
+
+        const __m128i bc = _mm_or_si128( _mm_and_si128( useB, b ), _mm_andnot_si128( useB, c ) );
+
+        return _mm_or_si128( _mm_and_si128( useA, a ), _mm_andnot_si128( useA, bc ) );
+    }
+#endif
+
+    void PngFilterRow( PngRowFilter filter, const uint8_t* row, const uint8_t* prev, uint8_t* out, std::size_t rowSize, std::size_t bpp )
+    {
+        std::size_t i = 0;
+
+        switch( filter )
+        {
+            case PngRowFilter::None:
+                std::memcpy( out, row, rowSize );
+                return;
+
+            case PngRowFilter::Sub:
+                for( ; i < bpp && i < rowSize; i++ )
+                    out[i] = row[i];
+#ifdef FRM2PNG_SSE2
+                for( ; i + 16 <= rowSize; i += 16 )
+                    Store( out + i, _mm_sub_epi8( Load( row + i ), Load( row + i - bpp ) ) );
+#endif
+                for( ; i < rowSize; i++ )
+                    out[i] = static_cast<uint8_t>( row[i] - row[i - bpp] );
+                return;
+
+            case PngRowFilter::Up:
+#ifdef FRM2PNG_SSE2
+                for( ; i + 16 <= rowSize; i += 16 )
+                    Store( out + i, _mm_sub_epi8( Load( row + i ), Load( prev + i ) ) );
+#endif
+                for( ; i < rowSize; i++ )
+                    out[i] = static_cast<uint8_t>( row[i] - prev[i] );
+                return;
+
+            case PngRowFilter::Average:
+                for( ; i < bpp && i < rowSize; i++ )
+                    out[i] = static_cast<uint8_t>( row[i] - ( prev[i] >> 1 ) );
+#ifdef FRM2PNG_SSE2
+                for( ; i + 16 <= rowSize; i += 16 )
+                {
+                    const __m128i a = Load( row + i - bpp );
+                    const __m128i b = Load( prev + i );
+
+                    // _mm_avg_epu8 rounds up, filter needs (a + b) >> 1
+                    const __m128i avg = _mm_sub_epi8( _mm_avg_epu8( a, b ), _mm_and_si128( _mm_xor_si128( a, b ), _mm_set1_epi8( 1 ) ) );
+
+                    Store( out + i, _mm_sub_epi8( Load( row + i ), avg ) );
+                }
+#endif
+                for( ; i < rowSize; i++ )
+                    out[i] = static_cast<uint8_t>( row[i] - ( ( row[i - bpp] + prev[i] ) >> 1 ) );
+                return;
+
+            case PngRowFilter::Paeth:
+                for( ; i < bpp && i < rowSize; i++ )
+                    out[i] = static_cast<uint8_t>( row[i] - prev[i] ); // Paeth( 0, b, 0 ) == b
+#ifdef FRM2PNG_SSE2
+                for( ; i + 16 <= rowSize; i += 16 )
+                {
+                    const __m128i zero = _mm_setzero_si128();
+                    const __m128i a    = Load( row + i - bpp );
+                    const __m128i b    = Load( prev + i );
+                    const __m128i c    = Load( prev + i - bpp );
+
+                    const __m128i lo = Paeth16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ), _mm_unpacklo_epi8( c, zero ) );
+                    const __m128i hi = Paeth16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ), _mm_unpackhi_epi8( c, zero ) );
+
+                    Store( out + i, _mm_sub_epi8( Load( row + i ), _mm_packus_epi16( lo, hi ) ) );
+                }
+#endif
+                for( ; i < rowSize; i++ )
+                    out[i] = static_cast<uint8_t>( row[i] - Paeth( row[i - bpp], prev[i], prev[i - bpp] ) );
+                return;
+        }
+
+        throw std::runtime_error( "PngFilterRow() - Unknown filter " + std::to_string( static_cast<uint8_t>( filter ) ) );
+    }
+
+    std::size_t PngFilterSum( const uint8_t* data, std::size_t size )
+    {
+        std::size_t sum = 0, i = 0;
+
+#ifdef FRM2PNG_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i       acc  = zero;
+
+        for( ; i + 16 <= size; i += 16 )
+        {
+            const __m128i value = Load( data + i );
+
+            // |x| for signed byte x equals min( x, 256 - x ) for same byte treated as unsigned
+            acc = _mm_add_epi64( acc, _mm_sad_epu8( _mm_min_epu8( value, _mm_sub_epi8( zero, value ) ), zero ) );
+        }
+
+        sum += static_cast<std::size_t>( _mm_cvtsi128_si32( acc ) ) + static_cast<std::size_t>( _mm_cvtsi128_si32( _mm_srli_si128( acc, 8 ) ) );
+#endif
+
+        for( ; i < size; i++ )
+        {
+            sum += data[i] < 128 ? data[i] : 256 - data[i];
+        }
+
+        return sum;
+    }
+
+    //
+    // PngFilter
+    //
+
+    static constexpr std::size_t BruteHistory = 32768;
+
+    PngFilter::PngFilter( PngFilterMode mode, std::size_t rowSize, std::size_t bpp, int level ) :
+        _mode( mode ),
+        _rowSize( rowSize ),
+        _bpp( bpp ),
+        _zero( rowSize, 0 ),
+        _best( rowSize + 1 ),
+        _candidate( rowSize + 1 )
+    {
+        if( _mode == PngFilterMode::Brute )
+        {
+            std::memset( &_trial, 0, sizeof( _trial ) );
+
+            if( deflateInit2( &_trial, level, Z_DEFLATED, 15, 8, Z_FILTERED ) != Z_OK )
+                throw std::runtime_error( "PngFilter::PngFilter() - Could not initialize zlib" );
+
+            _trialInit = true;
+            _trialOut.resize( deflateBound( &_trial, static_cast<uLong>( rowSize + 1 ) ) );
+        }
+    }
+
+    PngFilter::~PngFilter()
+    {
+        if( _trialInit )
+            deflateEnd( &_trial );
+    }
+
+    const std::vector<uint8_t>& PngFilter::filter( const uint8_t* row, const uint8_t* prev )
+    {
+        if( !prev )
+            prev = _zero.data();
+
+        // no point in filtering paletted images, values are indexes rather than colors
+        if( _mode == PngFilterMode::None || ( _mode == PngFilterMode::Paletted && _bpp == 1 ) )
+        {
+            _best[0] = static_cast<uint8_t>( PngRowFilter::None );
+            std::memcpy( &_best[1], row, _rowSize );
+
+            return _best;
+        }
+
+        std::size_t bestScore = 0;
+        bool        first     = true;
+
+        for( PngRowFilter type : { PngRowFilter::None, PngRowFilter::Sub, PngRowFilter::Up, PngRowFilter::Average, PngRowFilter::Paeth } )
+        {
+            _candidate[0] = static_cast<uint8_t>( type );
+            PngFilterRow( type, row, prev, &_candidate[1], _rowSize, _bpp );
+
+            const std::size_t score = _mode == PngFilterMode::Brute ? trial( _candidate ) : PngFilterSum( &_candidate[1], _rowSize );
+
+            if( first || score < bestScore )
+            {
+                bestScore = score;
+                first     = false;
+                _best.swap( _candidate );
+            }
+        }
+
+        if( _mode == PngFilterMode::Brute )
+        {
+            _history.insert( _history.end(), _best.begin(), _best.end() );
+            if( _history.size() > BruteHistory * 2 )
+                _history.erase( _history.begin(), _history.end() - BruteHistory );
+        }
+
+        return _best;
+    }
+
+    // compressed size of filtered row, with previously selected rows used as dictionary
+    std::size_t PngFilter::trial( const std::vector<uint8_t>& filtered )
+    {
+        deflateReset( &_trial );
+
+        if( !_history.empty() )
+        {
+            const std::size_t dictionary = std::min( _history.size(), BruteHistory );
+            deflateSetDictionary( &_trial, &_history[_history.size() - dictionary], static_cast<uInt>( dictionary ) );
+        }
+
+        _trial.next_in   = const_cast<Bytef*>( filtered.data() );
+        _trial.avail_in  = static_cast<uInt>( filtered.size() );
+        _trial.next_out  = _trialOut.data();
+        _trial.avail_out = static_cast<uInt>( _trialOut.size() );
+
+        deflate( &_trial, Z_FINISH );
+
+        return _trial.total_out;
+    }
+}
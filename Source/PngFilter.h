@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Third party includes
+#include <zlib.h>
+
+namespace frm2png
+{
+    // row filter types, as stored in front of each filtered row
+    enum class PngRowFilter : uint8_t
+    {
+        None    = 0,
+        Sub     = 1,
+        Up      = 2,
+        Average = 3,
+        Paeth   = 4
+    };
+
+    // how filter is selected for each row
+    enum class PngFilterMode : uint8_t
+    {
+        None,     // rows are not filtered
+        Sum,      // minimum sum of absolute differences
+        Paletted, // no filtering for paletted images, Sum for everything else
+        Brute     // compresses row with every filter, keeps smallest result; slow
+    };
+
+    bool               PngFilterModeFromString( const std::string& name, PngFilterMode& mode );
+    const std::string& PngFilterModeToString( PngFilterMode mode );
+
+    // filters single row; prev must point to row of zeros when filtering first row
+    // uses SSE2 when available
+    void PngFilterRow( PngRowFilter filter, const uint8_t* row, const uint8_t* prev, uint8_t* out, std::size_t rowSize, std::size_t bpp );
+
+    // sum of filtered bytes treated as signed values; smaller sum usually means better compression
+    std::size_t PngFilterSum( const uint8_t* data, std::size_t size );
+
+    // filters image rows one by one, selecting filter using given mode
+    class PngFilter
+    {
+    protected:
+        PngFilterMode _mode;
+        std::size_t   _rowSize;
+        std::size_t   _bpp;
+
+        std::vector<uint8_t> _zero;
+        std::vector<uint8_t> _best;
+        std::vector<uint8_t> _candidate;
+
+        // Brute mode only
+        z_stream             _trial;
+        bool                 _trialInit = false;
+        std::vector<uint8_t> _trialOut;
+        std::vector<uint8_t> _history;
+
+    public:
+        PngFilter( PngFilterMode mode, std::size_t rowSize, std::size_t bpp, int level );
+        PngFilter( const PngFilter& ) = delete;
+        PngFilter& operator=( const PngFilter& ) = delete;
+        ~PngFilter();
+
+        // returns filter type byte followed by filtered row; valid until next call
+        // prev is nullptr for first row
+        const std::vector<uint8_t>& filter( const uint8_t* row, const uint8_t* prev );
+
+    protected:
+        std::size_t trial( const std::vector<uint8_t>& filtered );
+    };
+}
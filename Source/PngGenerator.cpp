@@ -23,7 +23,10 @@
 // C++ standard includes
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <functional>
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -31,23 +34,123 @@
 #include <vector>
 
 // frm2png includes
+#include "AnimWriter.h"
+#include "ApngWriter.h"
+#include "Json.h"
 #include "Logging.h"
+#include "PngEncoder.h"
 #include "PngGenerator.h"
 #include "PngImage.h"
+#include "PngPalette.h"
+#include "PngScale.h"
 #include "PngWriter.h"
+#include "QoiWriter.h"
+#include "RawSprite.h"
+#include "RectPacker.h"
+#include "Sidecar.h"
+#include "Sink.h"
 
 // falltergeist includes
 #include "Format/Frm/File.h"
-#include "Format/Pal/Color.h"
-#include "Format/Pal/File.h"
 
 namespace frm2png
 {
-    PngGeneratorData::PngGeneratorData( Falltergeist::Format::Frm::File&& frm, Falltergeist::Format::Pal::File&& pal ) :
+    bool OutputFormatFromString( const std::string& name, OutputFormat& format )
+    {
+        if( name == "png" )
+            format = OutputFormat::Png;
+        else if( name == "qoi" )
+            format = OutputFormat::Qoi;
+        else if( name == "qoi-frames" )
+            format = OutputFormat::QoiFrames;
+        else
+            return false;
+
+        return true;
+    }
+
+    std::string OutputFormatExtension( OutputFormat format )
+    {
+        return format == OutputFormat::Png ? ".png" : ".qoi";
+    }
+
+    PngGeneratorData::PngGeneratorData( Falltergeist::Format::Frm::File&& frm, std::shared_ptr<const PaletteTable> palette ) :
         Frm( std::move( frm ) ),
-        Pal( std::move( pal ) )
+        Palette( std::move( palette ) )
     {}
 
+    void PngRenderCache::plan( const std::string& key )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        _images[key].Uses++;
+    }
+
+    void PngRenderCache::prune()
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        for( auto it = _images.begin(); it != _images.end(); )
+        {
+            if( it->second.Uses < 2 )
+                it = _images.erase( it );
+            else
+                ++it;
+        }
+    }
+
+    bool PngRenderCache::shared( const std::string& key )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        return _images.find( key ) != _images.end();
+    }
+
+    const PngImage* PngRenderCache::find( const std::string& key )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        auto it = _images.find( key );
+
+        return it != _images.end() ? it->second.Image.get() : nullptr;
+    }
+
+    const PngImage& PngRenderCache::insert( const std::string& key, std::unique_ptr<PngImage> image )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        Entry& entry = _images[key];
+        if( !entry.Image )
+            entry.Image = std::move( image );
+
+        return *entry.Image;
+    }
+
+    void PngRenderCache::release( const std::string& key )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        auto it = _images.find( key );
+        if( it != _images.end() && !--it->second.Uses )
+            _images.erase( it );
+    }
+
+    void PngOutputList::add( const std::string& filename )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        // same file can be written more than once, e.g. raw sprite, which doesn't depend on format
+        if( std::find( _files.begin(), _files.end(), filename ) == _files.end() )
+            _files.push_back( filename );
+    }
+
+    std::vector<std::string> PngOutputList::files()
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        return _files;
+    }
+
     //
     // helpers
     //
@@ -138,278 +241,1594 @@ namespace frm2png
         return result;
     }
 
-    // copy pixels from .frm to .png, starting at given position; adjusts RGB
-    static void DrawFrame( const PngGeneratorData& data, const Falltergeist::Format::Frm::Frame& frame, PngImage& image, const uint32_t pngX = 0, const uint32_t pngY = 0 )
+    // copy pixels of given .frm frame area to .png, starting at given position; adjusts RGB
+    static void DrawFrameArea( const PngGeneratorData& data, const Falltergeist::Format::Frm::Frame& frame, PngImage& image, const uint32_t pngX, const uint32_t pngY, const uint32_t areaX, const uint32_t areaY, const uint32_t areaWidth, const uint32_t areaHeight, Logging& log )
+    {
+        for( uint16_t x = areaX; x < areaX + areaWidth; x++ )
+        {
+            for( uint16_t y = areaY; y < areaY + areaHeight; y++ )
+            {
+                const uint8_t  index = frame.ColorIndex( x, y );
+                const uint8_t* color = data.Palette->Colors[index];
+                if( index >= PaletteFirstMagicColor )
+                    log.Report( "png[" + data.PngBasename + data.PngExtension + "] frame[" + std::to_string( frame.Index ) + "] x[" + std::to_string( x ) + "] y[" + std::to_string( y ) + "] magicColorIndex[" + std::to_string( index ) + "]" );
+                image.setPixel( pngX + x - areaX, pngY + y - areaY, color[0], color[1], color[2], color[3] );
+            }
+        }
+    }
+
+    // finds smallest area of .frm frame containing all visible pixels; returns false if frame is fully transparent
+    static bool TrimFrame( const PngGeneratorData& data, const Falltergeist::Format::Frm::Frame& frame, uint32_t& areaX, uint32_t& areaY, uint32_t& areaWidth, uint32_t& areaHeight )
     {
-        for( uint16_t x = 0; x < frame.Width; x++ )
+        uint32_t minX = frame.Width, maxX = 0, minY = frame.Height, maxY = 0;
+
+        for( uint16_t y = 0; y < frame.Height; y++ )
         {
-            for( uint16_t y = 0; y < frame.Height; y++ )
+            for( uint16_t x = 0; x < frame.Width; x++ )
             {
-                const Falltergeist::Format::Pal::Color& color = data.Pal.Get( frame.ColorIndex( x, y ) );
-                if( color.Index >= 229 )
-                    std::printf( "png[%s%s] frame[%u] x[%u] y[%u] magicColorIndex[%u]\n", data.PngBasename.c_str(), data.PngExtension.c_str(), frame.Index, x, y, color.Index );
-                image.setPixel( pngX + x, pngY + y, color.R, color.G, color.B, color.A );
+                if( !data.Palette->Colors[frame.ColorIndex( x, y )][3] )
+                    continue;
+
+                minX = std::min<uint32_t>( minX, x );
+                maxX = std::max<uint32_t>( maxX, x );
+                minY = std::min<uint32_t>( minY, y );
+                maxY = std::max<uint32_t>( maxY, y );
             }
         }
+
+        if( minX > maxX )
+        {
+            areaX = areaY = areaWidth = areaHeight = 0;
+            return false;
+        }
+
+        areaX      = minX;
+        areaY      = minY;
+        areaWidth  = maxX - minX + 1;
+        areaHeight = maxY - minY + 1;
+
+        return true;
+    }
+
+    static void AddOutput( const PngGeneratorData& data, const std::string& filename )
+    {
+        if( data.Outputs )
+            data.Outputs->add( filename );
     }
 
+    static void WriteText( const PngGeneratorOutput& output, const std::string& filename, const std::string& text )
+    {
+        std::unique_ptr<Sink> sink = CreateFileSink( output.Sinks, filename, text.size() );
+        sink->write( reinterpret_cast<const uint8_t*>( text.data() ), text.size() );
+        sink->close();
+    }
+
+    // each frame is displayed for 1/fps second
+    static constexpr uint16_t DelayNum = 1;
+
     static inline uint16_t GetDelayDen( const Falltergeist::Format::Frm::File& frm )
     {
-        return static_cast<uint16_t>( 1000 / ( frm.FramesPerSecond ? frm.FramesPerSecond : 10 ) );
+        return frm.FramesPerSecond ? frm.FramesPerSecond : 10;
     }
 
-    //
-    // generators
-    //
+    // palette used by indexed images; built from .pal, so it matches colors used by DrawFrame()
+    static PngPalette GetPngPalette( const PngGeneratorData& data )
+    {
+        PngPalette palette;
 
-    // original generator by falltergeist team
-    // all frames are drawn as single static image; each direction draws frames in its own row, from left to right
-    static void GeneratorLegacy( const PngGeneratorData& data, Logging& logVerbose )
+        for( const uint8_t* color : data.Palette->Colors )
+            palette.add( color[0], color[1], color[2], color[3] );
+
+        return palette;
+    }
+
+    static void ReportEncoder( const PngGeneratorOutput& output, const std::string& filename, const std::string& summary, Logging& logVerbose )
     {
-        uint16_t maxWidth  = data.Frm.MaxFrameWidth();
-        uint16_t maxHeight = data.Frm.MaxFrameHeight();
+        logVerbose << "encoder = " + summary;
+
+        if( output.Optimize )
+            logVerbose.Report( "png[" + filename + "] optimize[" + summary + "]" );
+    }
 
-        PngImage image( maxWidth * data.Frm.FramesPerDirection, maxHeight * data.Frm.DirectionsSize() );
+    // settings tried when encoding image; paletted settings are skipped if generator doesn't support them
+    static std::vector<PngEncoderSettings> GetEncoderCandidates( const PngGeneratorOutput& output, const bool indexed )
+    {
+        std::vector<PngEncoderSettings> candidates = PngEncoderCandidates( output.Encoder, output.Optimize );
 
-        for( const auto& dir : data.Frm.Directions() )
+        if( !indexed )
         {
-            uint16_t frameIdx = 0;
-            for( const auto& frame : dir.Frames() )
-            {
-                const uint32_t pngX = maxWidth * frameIdx;
-                const uint32_t pngY = maxHeight * dir.Index;
+            candidates.erase( std::remove_if( candidates.begin(), candidates.end(), []( const PngEncoderSettings& settings ) { return settings.Indexed; } ), candidates.end() );
 
-                DrawFrame( data, frame, image, pngX, pngY );
-                frameIdx++;
+            if( candidates.empty() )
+            {
+                candidates.push_back( output.Encoder );
+                candidates.back().Indexed = false;
             }
         }
 
-        logVerbose << "write png = " + data.PngPath + data.PngBasename + data.PngExtension + " = " + std::to_string( image.width() ) + "x" + std::to_string( image.height() );
-        PngWriter png( data.PngPath + data.PngBasename + data.PngExtension );
-        png.write( image );
+        return candidates;
     }
 
-    // based on `legacy` generator
-    // all frames are drawn as single static image; each direction draws frames (aligned to bottom) in its own row, from left to right
-    static void GeneratorStatic( const PngGeneratorData& data, Logging& logVerbose )
+    // AnimWriter::writeAnimEnd() must be called via FinishAnimWriter() so optimization results can be reported
+    static std::unique_ptr<AnimWriter> CreateAnimWriter( const PngGeneratorData& data, const std::string& filename, const bool indexed )
     {
-        uint16_t maxWidth  = data.Frm.MaxFrameWidth();
-        uint16_t maxHeight = data.Frm.MaxFrameHeight();
+        if( data.Format != OutputFormat::Png )
+            return std::unique_ptr<AnimWriter>( new QoiWriter( filename, data.Format == OutputFormat::QoiFrames, data.Sinks ) );
+
+        if( data.Pool )
+        {
+            const PngPalette palette = GetPngPalette( data );
+            return std::unique_ptr<AnimWriter>( new ApngWriter( filename, *data.Pool, GetEncoderCandidates( data, indexed ), &palette, data.Sinks ) );
+        }
 
-        PngImage image( maxWidth * data.Frm.FramesPerDirection, maxHeight * data.Frm.DirectionsSize() );
+        return std::unique_ptr<AnimWriter>( new PngWriter( filename, data.Sinks ) );
+    }
 
-        for( const auto& dir : data.Frm.Directions() )
+    static void FinishAnimWriter( const PngGeneratorData& data, AnimWriter& png, const std::string& filename, Logging& logVerbose )
+    {
+        png.writeAnimEnd();
+
+        if( const ApngWriter* apng = dynamic_cast<const ApngWriter*>( &png ) )
+            ReportEncoder( data, filename, apng->summary(), logVerbose );
+
+        if( const QoiWriter* qoi = dynamic_cast<const QoiWriter*>( &png ) )
         {
-            uint16_t frameIdx = 0;
-            for( const auto& frame : dir.Frames() )
-            {
-                const uint32_t pngX = maxWidth * frameIdx++;
-                const uint32_t pngY = ( maxHeight * dir.Index ) + ( maxHeight - frame.Height );
+            for( const std::string& file : qoi->files() )
+                AddOutput( data, file );
+        }
+        else
+            AddOutput( data, filename );
+    }
 
-                DrawFrame( data, frame, image, pngX, pngY );
-            }
+    static void WriteImage( const PngGeneratorOutput& output, const PngPalette& palette, const PngImage& image, const std::string& filename, const bool indexed, Logging& logVerbose )
+    {
+        if( output.Format != OutputFormat::Png )
+        {
+            QoiWriter qoi( filename, false, output.Sinks );
+            qoi.write( image );
+        }
+        else if( output.Pool )
+        {
+            std::unique_ptr<Sink> sink     = CreateFileSink( output.Sinks, filename );
+            PngEncoderSettings    settings = PngEncode( *sink, image, GetEncoderCandidates( output, indexed ), &palette, output.Pool );
+
+            ReportEncoder( output, filename, PngEncoderSettingsToString( settings ), logVerbose );
         }
+        else
+        {
+            PngWriter png( filename, output.Sinks );
+            png.write( image );
+        }
+    }
 
-        logVerbose << "write png = " + data.PngPath + data.PngBasename + data.PngExtension + " = " + std::to_string( image.width() ) + "x" + std::to_string( image.height() );
-        PngWriter png( data.PngPath + data.PngBasename + data.PngExtension );
-        png.write( image );
+    static void WritePng( const PngGeneratorData& data, const PngImage& image, const std::string& filename, const bool indexed, Logging& logVerbose )
+    {
+        WriteImage( data, GetPngPalette( data ), image, filename, indexed, logVerbose );
+        AddOutput( data, filename );
     }
 
-    // create multiple animated .png files (one per direction)
-    static void GeneratorAnim( const PngGeneratorData& data, Logging& logVerbose )
+    // sidecar with fields shared by all generators
+    static Sidecar CreateSidecar( const PngGeneratorData& data, const std::string& filename, uint32_t width, uint32_t height )
     {
-        for( const auto& dir : data.Frm.Directions() )
+        const std::string::size_type slash = filename.find_last_of( '/' );
+
+        Sidecar sidecar;
+        sidecar.Image              = slash == std::string::npos ? filename : filename.substr( slash + 1 );
+        sidecar.Width              = width;
+        sidecar.Height             = height;
+        sidecar.FramesPerSecond    = GetDelayDen( data.Frm );
+        sidecar.ActionFrame        = data.Frm.ActionFrame;
+        sidecar.FramesPerDirection = data.Frm.FramesPerDirection;
+
+        return sidecar;
+    }
+
+    static void AddSidecarFrame( Sidecar& sidecar, const Falltergeist::Format::Frm::Frame& frame, uint32_t direction, uint32_t pngX, uint32_t pngY )
+    {
+        sidecar.Frames.push_back( { direction, frame.Index, pngX, pngY, frame.Width, frame.Height, frame.OffsetX, frame.OffsetY, static_cast<int32_t>( pngX + frame.Width / 2 ), static_cast<int32_t>( pngY + frame.Height ) } );
+    }
+
+    // QOI sheet places animation frames next to each other, see QoiWriter; each frame is drawn in sheet column matching its index,
+    // and hidden preview image is skipped; direction areas describe first column
+    static Sidecar GetQoiSheetSidecar( const PngOutputPlan& plan )
+    {
+        Sidecar        sidecar = plan.Metadata;
+        const uint32_t columns = static_cast<uint32_t>( plan.Frames.size() - ( plan.Preview ? 1 : 0 ) );
+
+        sidecar.Width = plan.Width * columns;
+
+        for( auto& frame : sidecar.Frames )
         {
-            const std::string pngName  = data.PngPath + data.PngBasename + "_" + std::to_string( dir.Index ) + data.PngExtension;
-            uint32_t          pngWidth = 0, pngHeight = 0;
+            frame.X        += frame.Frame * plan.Width;
+            frame.HotspotX += static_cast<int32_t>( frame.Frame * plan.Width );
+        }
 
-            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
-            PngOffsets offsets = ConvertOffsets( dir.Frames(), pngWidth, pngHeight, logVerbose );
+        return sidecar;
+    }
 
-            logVerbose << "write png = " + pngName + " = " + std::to_string( pngWidth ) + "x" + std::to_string( pngHeight ) << 1;
-            PngWriter png( pngName );
+    // metadata files are named after image, without its extension, unless more than one format is written
+    static std::string GetMetadataBasename( const PngGeneratorData& data, const std::string& imageFilename )
+    {
+        const std::string::size_type dot   = imageFilename.find_last_of( '.' );
+        const std::string::size_type slash = imageFilename.find_last_of( '/' );
 
-            png.writeAnimHeader( pngWidth, pngHeight, dir.FramesSize() + ( firstIsAnim ? 0 : 1 ), 0, !firstIsAnim );
+        if( data.MultipleFormats || dot == std::string::npos || ( slash != std::string::npos && dot < slash ) )
+            return imageFilename;
 
-            // TODO
-            if( !firstIsAnim )
-            {
-                // if first image is not supposed to be part of animation, copy of first frame is added and moved to center
-                // software supporting APNG will ignore it, anything else will use that as image to display
+        return imageFilename.substr( 0, dot );
+    }
 
-                auto&    frame = dir.Frames().front();
-                PngImage defaultImage( pngWidth, pngHeight );
+    static void WriteSidecar( const PngGeneratorData& data, const Sidecar& sidecar, const std::string& filename, Logging& logVerbose )
+    {
+        if( data.Metadata == SidecarFormat::None )
+            return;
 
-                // draw .png frame
+        const std::string sidecarFilename = SidecarWrite( sidecar, data.Metadata, GetMetadataBasename( data, filename ), data.Sinks );
 
-                const uint32_t pngX = pngWidth / 2 - frame.Width / 2;
-                const uint32_t pngY = pngHeight / 2 - frame.Height / 2;
+        logVerbose << "write sidecar = " + sidecarFilename;
+        AddOutput( data, sidecarFilename );
+    }
 
-                DrawFrame( data, frame, defaultImage, pngX, pngY );
+    // finds smallest area containing all pixels which differs between two images of same size
+    // returns false if images are identical
+    static bool FindChangedArea( const PngImage& prev, const PngImage& curr, uint32_t& areaX, uint32_t& areaY, uint32_t& areaWidth, uint32_t& areaHeight )
+    {
+        const uint32_t rowSize = curr.width() * 4;
+        uint32_t       minX = curr.width(), maxX = 0, minY = curr.height(), maxY = 0;
 
-                png.writeAnimFrame( defaultImage,
-                                    0, 0, // offsets
-                                    0, 0, // delay
-                                    0, 0  // dispose, blend
-                );
-            }
+        for( uint32_t y = 0; y < curr.height(); y++ )
+        {
+            png_const_bytep prevRow = prev.rows()[y];
+            png_const_bytep currRow = curr.rows()[y];
 
-            // draw .png frames
-            bool first = true;
-            for( const auto& frame : dir.Frames() )
-            {
-                logVerbose << "draw frame:" + std::to_string( frame.Index ) + " @ " + std::to_string( offsets[frame.Index].first ) + "," + std::to_string( offsets[frame.Index].second ) + " -> " + std::to_string( frame.Width ) + "x" + std::to_string( frame.Height );
+            if( std::memcmp( prevRow, currRow, rowSize ) == 0 )
+                continue;
 
-                if( firstIsAnim && first )
-                {
-                    PngImage image( pngWidth, pngHeight );
-                    DrawFrame( data, frame, image, offsets[frame.Index].first, offsets[frame.Index].second );
-                    png.writeAnimFrame( image, 0, 0, 0, GetDelayDen( data.Frm ), PNG_DISPOSE_OP_BACKGROUND, PNG_BLEND_OP_SOURCE );
+            minY = std::min( minY, y );
+            maxY = y;
 
-                    first = false;
-                }
-                else
-                {
-                    PngImage image( frame.Width, frame.Height );
-                    DrawFrame( data, frame, image );
-                    png.writeAnimFrame( image, offsets[frame.Index].first, offsets[frame.Index].second, 0, GetDelayDen( data.Frm ), PNG_DISPOSE_OP_BACKGROUND, PNG_BLEND_OP_SOURCE );
-                }
-            }
+            uint32_t x = 0;
+            while( std::memcmp( prevRow + x * 4, currRow + x * 4, 4 ) == 0 )
+                x++;
+            minX = std::min( minX, x );
 
-            png.writeAnimEnd();
-            logVerbose << -2;
+            x = curr.width() - 1;
+            while( std::memcmp( prevRow + x * 4, currRow + x * 4, 4 ) == 0 )
+                x--;
+            maxX = std::max( maxX, x );
         }
+
+        if( minY > maxY )
+            return false;
+
+        areaX      = minX;
+        areaY      = minY;
+        areaWidth  = maxX - minX + 1;
+        areaHeight = maxY - minY + 1;
+
+        return true;
     }
 
-    // create single animated .png files with all directions included
-    static void GeneratorAnimPacked( const PngGeneratorData& data, Logging& logVerbose )
+    // writes all APNG frames using already composed frames (all of same size)
+    // first frame is stored as-is, other frames store only area changed since previous frame; frames without changes extend previous frame delay
+    static void WriteAnimDelta( AnimWriter& png, const std::vector<const PngImage*>& canvases, const uint16_t delayDen, Logging& logVerbose )
     {
-        const std::string pngName  = data.PngPath + data.PngBasename + data.PngExtension;
-        uint32_t          pngWidth = 0, pngWidthLeft = 0, pngWidthRight = 0, pngHeight = 0, pngRightX = 0;
-        constexpr uint8_t pngSpacing = 4;
+        struct DeltaFrame
+        {
+            std::size_t Canvas;
+            uint32_t    X, Y, Width, Height;
+            uint16_t    DelayNum;
+        };
 
-        // TODO? fallback to 'anim' generator?
-        if( data.Frm.DirectionsSize() != DIR_MAX )
-            throw std::runtime_error( "GeneratorAnimPacked() - .frm file must contain frames for exactly " + std::to_string( DIR_MAX ) + " directions" );
+        std::vector<DeltaFrame> delta;
 
-        // cache size/offsets of all directions
+        for( std::size_t idx = 0; idx < canvases.size(); idx++ )
+        {
+            const PngImage& curr = *canvases[idx];
 
-        // dirSize[D].first  = direction D, width
-        // dirSize[D].second = direction D, height
-        std::vector<std::pair<uint32_t, uint32_t>> dirSize;
+            if( !idx )
+            {
+                delta.push_back( { idx, 0, 0, curr.width(), curr.height(), DelayNum } );
+                continue;
+            }
 
-        // dirOffsets[D][F].first  = direction D, frame F, offset X
-        // dirOffsets[D][F].second = direction D, frame F, offset Y
-        std::vector<PngOffsets> dirOffsets;
+            DeltaFrame frame = { idx, 0, 0, 0, 0, DelayNum };
+            if( FindChangedArea( *canvases[idx - 1], curr, frame.X, frame.Y, frame.Width, frame.Height ) || delta.back().DelayNum > UINT16_MAX - DelayNum )
+            {
+                // identical frame which cannot be merged is stored as 1x1 area
+                if( !frame.Width )
+                    frame.Width = frame.Height = 1;
 
-        for( const auto& dir : data.Frm.Directions() )
+                delta.push_back( frame );
+            }
+            else
+            {
+                logVerbose << "delta frame:" + std::to_string( idx ) + " unchanged, merged with frame:" + std::to_string( delta.back().Canvas );
+                delta.back().DelayNum += DelayNum;
+            }
+        }
+
+        png.writeAnimHeader( canvases.front()->width(), canvases.front()->height(), static_cast<uint32_t>( delta.size() ), 0, false );
+
+        for( const auto& frame : delta )
         {
-            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+            PngImage image( *canvases[frame.Canvas], frame.X, frame.Y, frame.Width, frame.Height );
+            uint8_t  blend = PNG_BLEND_OP_SOURCE;
 
-            uint32_t   dirWidth = 0, dirHeight = 0;
-            PngOffsets offsets = ConvertOffsets( dir.Frames(), dirWidth, dirHeight, logVerbose );
+            // if all changed pixels are opaque, unchanged pixels can be made transparent and blended over previous frame; compresses better
+            if( frame.Canvas )
+            {
+                const PngImage& prev   = *canvases[frame.Canvas - 1];
+                bool            opaque = true;
 
-            dirSize.emplace_back( dirWidth, dirHeight );
-            dirOffsets.emplace_back( offsets );
+                for( uint32_t y = 0; opaque && y < frame.Height; y++ )
+                {
+                    png_const_bytep prevRow = prev.rows()[frame.Y + y] + frame.X * 4;
+                    png_const_bytep currRow = image.rows()[y];
+
+                    for( uint32_t x = 0; x < frame.Width * 4; x += 4 )
+                    {
+                        if( std::memcmp( prevRow + x, currRow + x, 4 ) != 0 && currRow[x + 3] != 255 )
+                        {
+                            opaque = false;
+                            break;
+                        }
+                    }
+                }
 
-            logVerbose << -1;
+                if( opaque )
+                {
+                    blend = PNG_BLEND_OP_OVER;
+
+                    for( uint32_t y = 0; y < frame.Height; y++ )
+                    {
+                        png_const_bytep prevRow = prev.rows()[frame.Y + y] + frame.X * 4;
+                        png_bytep       currRow = image.rows()[y];
+
+                        for( uint32_t x = 0; x < frame.Width * 4; x += 4 )
+                        {
+                            if( std::memcmp( prevRow + x, currRow + x, 4 ) == 0 )
+                                std::memset( currRow + x, 0, 4 );
+                        }
+                    }
+                }
+            }
+
+            logVerbose << "delta frame:" + std::to_string( frame.Canvas ) + " @ " + std::to_string( frame.X ) + "," + std::to_string( frame.Y ) + " -> " + std::to_string( frame.Width ) + "x" + std::to_string( frame.Height ) + " delay:" + std::to_string( frame.DelayNum ) + "/" + std::to_string( delayDen ) + ( blend == PNG_BLEND_OP_OVER ? " over" : " source" );
+
+            png.writeAnimFrame( image, frame.X, frame.Y, frame.DelayNum, delayDen, PNG_DISPOSE_OP_NONE, blend );
         }
+    }
 
-        // find .png image size
+    //
+    // stages
+    //
 
-        for( uint8_t leftIdx = DIR_NW, rightIdx = DIR_NE; rightIdx <= DIR_SE; leftIdx--, rightIdx++ )
+    static PngPlacement PlaceFrame( const Falltergeist::Format::Frm::Frame& frame, const uint32_t pngX, const uint32_t pngY )
+    {
+        return { &frame, 0, 0, frame.Width, frame.Height, pngX, pngY };
+    }
+
+    static PngOutputPlan CreatePlan( const PngGeneratorData& data, const std::string& filename, const uint32_t width, const uint32_t height, const bool animated )
+    {
+        PngOutputPlan plan;
+        plan.Filename = filename;
+        plan.Width    = width;
+        plan.Height   = height;
+        plan.Animated = animated;
+        plan.Metadata = CreateSidecar( data, filename, width, height );
+
+        return plan;
+    }
+
+    // finds smallest area containing all placements; frame without placements uses 1x1 area
+    static void FindPlacementsArea( const std::vector<PngPlacement>& placements, uint32_t& areaX, uint32_t& areaY, uint32_t& areaWidth, uint32_t& areaHeight )
+    {
+        if( placements.empty() )
         {
-            logVerbose << "dirSize " + std::to_string( leftIdx ) + ":" + std::to_string( dirSize[leftIdx].first ) + "," + std::to_string( dirSize[leftIdx].second ) + " " + std::to_string( rightIdx ) + ":" + std::to_string( dirSize[rightIdx].first ) + "," + std::to_string( dirSize[rightIdx].second );
+            areaX = areaY = 0;
+            areaWidth = areaHeight = 1;
+            return;
+        }
 
-            pngWidthLeft  = std::max( pngWidthLeft, dirSize[leftIdx].first );
-            pngWidthRight = std::max( pngWidthLeft, dirSize[rightIdx].first );
+        uint32_t minX = UINT32_MAX, minY = UINT32_MAX, maxX = 0, maxY = 0;
 
-            pngWidth = std::max( pngWidth, pngWidthLeft + pngSpacing + pngWidthRight ) + 2;
-            pngHeight += ( rightIdx > DIR_NE ? pngSpacing : 0 ) + std::max( dirSize[leftIdx].second, dirSize[rightIdx].second );
-            pngRightX = std::max( pngRightX, dirSize[leftIdx].first + pngSpacing );
+        for( const auto& placement : placements )
+        {
+            minX = std::min( minX, placement.X );
+            minY = std::min( minY, placement.Y );
+            maxX = std::max( maxX, placement.X + placement.AreaWidth );
+            maxY = std::max( maxY, placement.Y + placement.AreaHeight );
         }
 
-        logVerbose << "write png = " + pngName + " = " + std::to_string( pngWidth ) + "x" + std::to_string( pngHeight );
-        PngWriter png( pngName );
+        areaX      = minX;
+        areaY      = minY;
+        areaWidth  = std::max<uint32_t>( 1, maxX - minX );
+        areaHeight = std::max<uint32_t>( 1, maxY - minY );
+    }
 
-        png.writeAnimHeader( pngWidth, pngHeight, data.Frm.FramesPerDirection + ( firstIsAnim ? 0 : 1 ), 0, !firstIsAnim );
+    // key used to find frames with identical layout in render cache
+    static std::string RenderCacheKey( const std::vector<PngPlacement>& placements, const uint32_t areaX, const uint32_t areaY, const uint32_t areaWidth, const uint32_t areaHeight )
+    {
+        std::string key = std::to_string( areaX ) + "," + std::to_string( areaY ) + "," + std::to_string( areaWidth ) + "x" + std::to_string( areaHeight );
 
-        // TODO
-        if( !firstIsAnim )
+        for( const auto& placement : placements )
         {
-            PngImage defaultImage( pngWidth, pngHeight );
-            png.writeAnimFrame( defaultImage, 0, 0, 0, 0, 0, 0 );
+            key += ":" + std::to_string( reinterpret_cast<uintptr_t>( placement.Frame ) ) + "," + std::to_string( placement.AreaX ) + "," + std::to_string( placement.AreaY ) + "," + std::to_string( placement.AreaWidth ) + "x" + std::to_string( placement.AreaHeight );
+            key += "@" + std::to_string( placement.X ) + "," + std::to_string( placement.Y );
         }
 
-        //
+        return key;
+    }
 
-        for( uint16_t frameIdx = 0; frameIdx < data.Frm.FramesPerDirection; frameIdx++ )
-        {
-            logVerbose << "frame " + std::to_string( frameIdx ) << 1;
-            PngImage image( pngWidth, pngHeight );
+    // frames of plan drawn by WriteOutput() are [first, end)
+    static void GetRenderedFrames( const PngGeneratorData& data, const PngOutputPlan& plan, std::size_t& first, std::size_t& end )
+    {
+        first = plan.Animated && data.AnimDelta && plan.Preview ? 1 : 0;
+        end   = plan.Animated ? plan.Frames.size() : 1;
+    }
 
-            for( const auto& dir : data.Frm.Directions() )
-            {
-                logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+    // area of output image covered by frame drawn by WriteOutput(); first animation frame covers whole image, other frames only
+    // area used by their placements, unless all frames are composed for delta mode
+    static void GetRenderedArea( const PngGeneratorData& data, const PngOutputPlan& plan, const std::size_t idx, uint32_t& areaX, uint32_t& areaY, uint32_t& areaWidth, uint32_t& areaHeight )
+    {
+        areaX      = 0;
+        areaY      = 0;
+        areaWidth  = plan.Width;
+        areaHeight = plan.Height;
 
-                uint32_t pngX = 0, pngY = 0, pngRow = ( dir.Index <= DIR_SE ? dir.Index : DIR_NW - dir.Index );
-                logVerbose << "pngRow = " + std::to_string( pngRow );
+        if( plan.Animated && !data.AnimDelta && idx )
+            FindPlacementsArea( plan.Frames[idx], areaX, areaY, areaWidth, areaHeight );
+    }
 
-                const Falltergeist::Format::Frm::Frame& frame = data.Frm.GetFrame( dir.Index, frameIdx );
+    // counts frames which will be drawn for plan; see PngRenderCache
+    static void PlanRenderCache( const PngGeneratorData& data, const PngOutputPlan& plan, PngRenderCache& cache )
+    {
+        std::size_t first, end;
+        GetRenderedFrames( data, plan, first, end );
 
-                // move *E frames to right column
-                if( dir.Index <= DIR_SE )
-                    pngX = pngRightX;
-                // align *W frames to right
-                else
-                    pngX = pngRightX - pngSpacing - dirSize[dir.Index].first;
+        for( std::size_t idx = first; idx < end; idx++ )
+        {
+            uint32_t areaX, areaY, areaWidth, areaHeight;
+            GetRenderedArea( data, plan, idx, areaX, areaY, areaWidth, areaHeight );
 
-                // align frames to bottom
+            cache.plan( RenderCacheKey( plan.Frames[idx], areaX, areaY, areaWidth, areaHeight ) );
+        }
+    }
 
-                logVerbose << "pngCurrDirs = " + std::to_string( dir.Index ) + "," + std::to_string( std::abs( DIR_NW - dir.Index ) );
-                pngY += std::max( dirSize[dir.Index].second, dirSize[std::abs( DIR_NW - dir.Index )].second ) - dirSize[dir.Index].second;
+    // render stage; draws placements of single frame, with given area of output image at 0,0
+    // returns image owned by render cache if frame is shared with other outputs, otherwise canvas is (re)used
+    // key is set for shared frames; caller passes it to PngRenderCache::release() when it's done with image
+    static const PngImage& RenderFrame( const PngGeneratorData& data, const std::vector<PngPlacement>& placements, const uint32_t areaX, const uint32_t areaY, const uint32_t areaWidth, const uint32_t areaHeight, std::unique_ptr<PngImage>& canvas, std::string& key, Logging& logVerbose )
+    {
+        key.clear();
 
-                // apply vertical spacing (except NE/NW)
+        if( data.RenderCache )
+        {
+            key = RenderCacheKey( placements, areaX, areaY, areaWidth, areaHeight );
 
-                pngY += pngSpacing * pngRow;
+            if( !data.RenderCache->shared( key ) )
+                key.clear();
+        }
 
-                // move frames to their rows (except NE/NW)
+        if( !key.empty() )
+        {
+            if( const PngImage* image = data.RenderCache->find( key ) )
+                return *image;
 
-                while( pngRow )
-                {
-                    logVerbose << "pngPrevDirs = " + std::to_string( DIR_MAX - pngRow ) + "," + std::to_string( pngRow - 1 );
-                    pngY += std::max( dirSize[DIR_MAX - pngRow].second, dirSize[pngRow - 1].second );
-                    pngRow--;
-                }
+            canvas.reset( new PngImage( areaWidth, areaHeight ) );
+        }
+        else if( canvas && canvas->width() == areaWidth && canvas->height() == areaHeight )
+        {
+            for( uint32_t y = 0; y < areaHeight; y++ )
+                std::memset( canvas->rows()[y], 0, areaWidth * 4 );
+        }
+        else
+            canvas.reset( new PngImage( areaWidth, areaHeight ) );
 
-                logVerbose << "pngX = " + std::to_string( pngX ) + " + " + std::to_string( dirOffsets[dir.Index][frame.Index].first );
-                logVerbose << "pngY = " + std::to_string( pngY ) + " + " + std::to_string( dirOffsets[dir.Index][frame.Index].second );
+        // placements never overlap, so they can be drawn at the same time
+        // if previous frame is still being compressed, workers switch between both tasks
+        // messages of each placement are cached, and printed in original order
+        PngImage&                             image = *canvas;
+        std::vector<std::future<void>>        draw;
+        std::vector<std::unique_ptr<Logging>> logs;
 
-                DrawFrame( data, frame, image, pngX + dirOffsets[dir.Index][frame.Index].first, pngY + dirOffsets[dir.Index][frame.Index].second );
-                logVerbose << -1;
+        for( const auto& placement : placements )
+        {
+            if( data.Pool && placements.size() > 1 )
+            {
+                logs.emplace_back( new Logging( logVerbose.Enabled, true, logVerbose.Indent ) );
+
+                Logging* log = logs.back().get();
+                draw.push_back( data.Pool->submit( [&data, &placement, &image, areaX, areaY, log]() { DrawFrameArea( data, *placement.Frame, image, placement.X - areaX, placement.Y - areaY, placement.AreaX, placement.AreaY, placement.AreaWidth, placement.AreaHeight, *log ); } ) );
             }
+            else
+                DrawFrameArea( data, *placement.Frame, image, placement.X - areaX, placement.Y - areaY, placement.AreaX, placement.AreaY, placement.AreaWidth, placement.AreaHeight, logVerbose );
+        }
 
-            png.writeAnimFrame( image,
-                                0, 0, // offsets
-                                0, GetDelayDen( data.Frm ),
-                                PNG_DISPOSE_OP_BACKGROUND, PNG_BLEND_OP_SOURCE );
-            logVerbose << -1;
+        for( auto& task : draw )
+            data.Pool->ready( task );
+        for( std::size_t idx = 0; idx < draw.size(); idx++ )
+        {
+            logVerbose.Replay( *logs[idx] );
+            draw[idx].get();
         }
 
-        png.writeAnimEnd();
-    }
+        if( !key.empty() )
+            return data.RenderCache->insert( key, std::move( canvas ) );
 
-    //
-    // used by main application
-    //
+        return image;
+    }
 
-    std::unordered_map<std::string, PngGeneratorFunc> Generator;
+    static void ReleaseFrame( const PngGeneratorData& data, const std::string& key )
+    {
+        if( !key.empty() )
+            data.RenderCache->release( key );
+    }
 
-    void InitPngGenerators()
+    // encode and sink stages; writes single planned output
+    static void WriteOutput( const PngGeneratorData& data, const PngOutputPlan& plan, const bool indexed, Logging& logVerbose )
     {
-        Generator["legacy"]      = &GeneratorLegacy;
-        Generator["static"]      = &GeneratorStatic;
-        Generator["anim"]        = &GeneratorAnim;
-        Generator["anim-packed"] = &GeneratorAnimPacked;
+        for( const auto& file : plan.Files )
+        {
+            logVerbose << "write file = " + file.first;
+            WriteText( data, file.first, file.second );
+            AddOutput( data, file.first );
+        }
+
+        if( !plan.Metadata.Image.empty() )
+            WriteSidecar( data, plan.Animated && data.Format == OutputFormat::Qoi ? GetQoiSheetSidecar( plan ) : plan.Metadata, plan.Filename, logVerbose );
+
+        logVerbose << "write png = " + plan.Filename + " = " + std::to_string( plan.Width ) + "x" + std::to_string( plan.Height );
+
+        // canvas is reused while frame size doesn't change, as writers don't need frame after writeAnimFrame() returns
+        std::unique_ptr<PngImage> canvas;
+        std::string               key;
+
+        if( !plan.Animated )
+        {
+            WritePng( data, RenderFrame( data, plan.Frames.front(), 0, 0, plan.Width, plan.Height, canvas, key, logVerbose ), plan.Filename, indexed, logVerbose );
+            ReleaseFrame( data, key );
+        }
+        else if( data.AnimDelta )
+        {
+            // delta mode needs all frames composed before anything is written; hidden default image is not used
+            std::vector<std::unique_ptr<PngImage>> owned;
+            std::vector<const PngImage*>           canvases;
+            std::vector<std::string>               keys;
+
+            std::size_t first, end;
+            GetRenderedFrames( data, plan, first, end );
+
+            for( std::size_t idx = first; idx < end; idx++ )
+            {
+                canvases.push_back( &RenderFrame( data, plan.Frames[idx], 0, 0, plan.Width, plan.Height, canvas, key, logVerbose ) );
+                keys.push_back( key );
+
+                if( canvas )
+                    owned.push_back( std::move( canvas ) );
+            }
+
+            std::unique_ptr<AnimWriter> png = CreateAnimWriter( data, plan.Filename, indexed );
+            WriteAnimDelta( *png, canvases, GetDelayDen( data.Frm ), logVerbose );
+            FinishAnimWriter( data, *png, plan.Filename, logVerbose );
+
+            for( const std::string& frameKey : keys )
+                ReleaseFrame( data, frameKey );
+        }
+        else
+        {
+            std::unique_ptr<AnimWriter> png = CreateAnimWriter( data, plan.Filename, indexed );
+            png->writeAnimHeader( plan.Width, plan.Height, static_cast<uint32_t>( plan.Frames.size() ), 0, plan.Preview );
+
+            for( std::size_t idx = 0; idx < plan.Frames.size(); idx++ )
+            {
+                uint32_t areaX, areaY, areaWidth, areaHeight;
+                GetRenderedArea( data, plan, idx, areaX, areaY, areaWidth, areaHeight );
+
+                logVerbose << "draw frame:" + std::to_string( idx ) + " @ " + std::to_string( areaX ) + "," + std::to_string( areaY ) + " -> " + std::to_string( areaWidth ) + "x" + std::to_string( areaHeight );
+                const PngImage& image = RenderFrame( data, plan.Frames[idx], areaX, areaY, areaWidth, areaHeight, canvas, key, logVerbose );
+
+                // software supporting APNG will ignore default image, anything else will use it as image to display
+                if( plan.Preview && !idx )
+                    png->writeAnimFrame( image, 0, 0, 0, 0, 0, 0 );
+                else
+                    png->writeAnimFrame( image, areaX, areaY, DelayNum, GetDelayDen( data.Frm ), PNG_DISPOSE_OP_BACKGROUND, PNG_BLEND_OP_SOURCE );
+
+                ReleaseFrame( data, key );
+            }
+
+            FinishAnimWriter( data, *png, plan.Filename, logVerbose );
+        }
+    }
+
+    //
+    // generators
+    //
+    // generators only plan outputs; see RunPngGenerator()
+    //
+
+    // original generator by falltergeist team
+    // all frames are drawn as single static image; each direction draws frames in its own row, from left to right
+    static std::vector<PngOutputPlan> PlanLegacy( const PngGeneratorData& data, Logging& )
+    {
+        uint16_t maxWidth  = data.Frm.MaxFrameWidth();
+        uint16_t maxHeight = data.Frm.MaxFrameHeight();
+
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + data.PngExtension, maxWidth * data.Frm.FramesPerDirection, maxHeight * data.Frm.DirectionsSize(), false ) );
+
+        PngOutputPlan& plan = plans.back();
+        plan.Frames.emplace_back();
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            plan.Metadata.Directions.push_back( { dir.Index, 0, static_cast<uint32_t>( maxHeight ) * dir.Index, plan.Width, maxHeight, 0, 0 } );
+
+            uint16_t frameIdx = 0;
+            for( const auto& frame : dir.Frames() )
+            {
+                const uint32_t pngX = maxWidth * frameIdx;
+                const uint32_t pngY = maxHeight * dir.Index;
+
+                plan.Frames.front().push_back( PlaceFrame( frame, pngX, pngY ) );
+                AddSidecarFrame( plan.Metadata, frame, dir.Index, pngX, pngY );
+                frameIdx++;
+            }
+        }
+
+        return plans;
+    }
+
+    // based on `legacy` generator
+    // all frames are drawn as single static image; each direction draws frames (aligned to bottom) in its own row, from left to right
+    static std::vector<PngOutputPlan> PlanStatic( const PngGeneratorData& data, Logging& )
+    {
+        uint16_t maxWidth  = data.Frm.MaxFrameWidth();
+        uint16_t maxHeight = data.Frm.MaxFrameHeight();
+
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + data.PngExtension, maxWidth * data.Frm.FramesPerDirection, maxHeight * data.Frm.DirectionsSize(), false ) );
+
+        PngOutputPlan& plan = plans.back();
+        plan.Frames.emplace_back();
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            plan.Metadata.Directions.push_back( { dir.Index, 0, static_cast<uint32_t>( maxHeight ) * dir.Index, plan.Width, maxHeight, 0, 0 } );
+
+            uint16_t frameIdx = 0;
+            for( const auto& frame : dir.Frames() )
+            {
+                const uint32_t pngX = maxWidth * frameIdx++;
+                const uint32_t pngY = ( maxHeight * dir.Index ) + ( maxHeight - frame.Height );
+
+                plan.Frames.front().push_back( PlaceFrame( frame, pngX, pngY ) );
+                AddSidecarFrame( plan.Metadata, frame, dir.Index, pngX, pngY );
+            }
+        }
+
+        return plans;
+    }
+
+    // create multiple animated .png files (one per direction)
+    static std::vector<PngOutputPlan> PlanAnim( const PngGeneratorData& data, Logging& logVerbose )
+    {
+        std::vector<PngOutputPlan> plans;
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            uint32_t pngWidth = 0, pngHeight = 0;
+
+            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+            PngOffsets offsets = ConvertOffsets( dir.Frames(), pngWidth, pngHeight, logVerbose );
+            logVerbose << -1;
+
+            plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + "_" + std::to_string( dir.Index ) + data.PngExtension, pngWidth, pngHeight, true ) );
+
+            PngOutputPlan& plan = plans.back();
+            plan.Metadata.Directions.push_back( { dir.Index, 0, 0, pngWidth, pngHeight, offsets.front().first, offsets.front().second } );
+
+            // TODO
+            if( !firstIsAnim )
+            {
+                // if first image is not supposed to be part of animation, copy of first frame is added and moved to center
+                const auto& frame = dir.Frames().front();
+
+                plan.Preview = true;
+                plan.Frames.push_back( { PlaceFrame( frame, pngWidth / 2 - frame.Width / 2, pngHeight / 2 - frame.Height / 2 ) } );
+            }
+
+            for( const auto& frame : dir.Frames() )
+            {
+                plan.Frames.push_back( { PlaceFrame( frame, offsets[frame.Index].first, offsets[frame.Index].second ) } );
+                AddSidecarFrame( plan.Metadata, frame, dir.Index, offsets[frame.Index].first, offsets[frame.Index].second );
+            }
+        }
+
+        return plans;
+    }
+
+    // create single animated .png files with all directions included
+    static std::vector<PngOutputPlan> PlanAnimPacked( const PngGeneratorData& data, Logging& logVerbose )
+    {
+        uint32_t          pngWidth = 0, pngWidthLeft = 0, pngWidthRight = 0, pngHeight = 0, pngRightX = 0;
+        constexpr uint8_t pngSpacing = 4;
+
+        // TODO? fallback to 'anim' generator?
+        if( data.Frm.DirectionsSize() != DIR_MAX )
+            throw std::runtime_error( "PlanAnimPacked() - .frm file must contain frames for exactly " + std::to_string( DIR_MAX ) + " directions" );
+
+        // cache size/offsets of all directions
+
+        // dirSize[D].first  = direction D, width
+        // dirSize[D].second = direction D, height
+        std::vector<std::pair<uint32_t, uint32_t>> dirSize;
+
+        // dirOffsets[D][F].first  = direction D, frame F, offset X
+        // dirOffsets[D][F].second = direction D, frame F, offset Y
+        std::vector<PngOffsets> dirOffsets;
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+
+            uint32_t   dirWidth = 0, dirHeight = 0;
+            PngOffsets offsets = ConvertOffsets( dir.Frames(), dirWidth, dirHeight, logVerbose );
+
+            dirSize.emplace_back( dirWidth, dirHeight );
+            dirOffsets.emplace_back( offsets );
+
+            logVerbose << -1;
+        }
+
+        // find .png image size
+
+        for( uint8_t leftIdx = DIR_NW, rightIdx = DIR_NE; rightIdx <= DIR_SE; leftIdx--, rightIdx++ )
+        {
+            logVerbose << "dirSize " + std::to_string( leftIdx ) + ":" + std::to_string( dirSize[leftIdx].first ) + "," + std::to_string( dirSize[leftIdx].second ) + " " + std::to_string( rightIdx ) + ":" + std::to_string( dirSize[rightIdx].first ) + "," + std::to_string( dirSize[rightIdx].second );
+
+            pngWidthLeft  = std::max( pngWidthLeft, dirSize[leftIdx].first );
+            pngWidthRight = std::max( pngWidthLeft, dirSize[rightIdx].first );
+
+            pngWidth = std::max( pngWidth, pngWidthLeft + pngSpacing + pngWidthRight ) + 2;
+            pngHeight += ( rightIdx > DIR_NE ? pngSpacing : 0 ) + std::max( dirSize[leftIdx].second, dirSize[rightIdx].second );
+            pngRightX = std::max( pngRightX, dirSize[leftIdx].first + pngSpacing );
+        }
+
+        // find position of each direction; it's the same for all frames
+
+        // dirPosition[D].first  = direction D, X
+        // dirPosition[D].second = direction D, Y
+        std::vector<std::pair<uint32_t, uint32_t>> dirPosition;
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+
+            uint32_t pngX = 0, pngY = 0, pngRow = ( dir.Index <= DIR_SE ? dir.Index : DIR_NW - dir.Index );
+            logVerbose << "pngRow = " + std::to_string( pngRow );
+
+            // move *E frames to right column
+            if( dir.Index <= DIR_SE )
+                pngX = pngRightX;
+            // align *W frames to right
+            else
+                pngX = pngRightX - pngSpacing - dirSize[dir.Index].first;
+
+            // align frames to bottom
+
+            logVerbose << "pngCurrDirs = " + std::to_string( dir.Index ) + "," + std::to_string( std::abs( DIR_NW - dir.Index ) );
+            pngY += std::max( dirSize[dir.Index].second, dirSize[std::abs( DIR_NW - dir.Index )].second ) - dirSize[dir.Index].second;
+
+            // apply vertical spacing (except NE/NW)
+
+            pngY += pngSpacing * pngRow;
+
+            // move frames to their rows (except NE/NW)
+
+            while( pngRow )
+            {
+                logVerbose << "pngPrevDirs = " + std::to_string( DIR_MAX - pngRow ) + "," + std::to_string( pngRow - 1 );
+                pngY += std::max( dirSize[DIR_MAX - pngRow].second, dirSize[pngRow - 1].second );
+                pngRow--;
+            }
+
+            logVerbose << "pngX = " + std::to_string( pngX );
+            logVerbose << "pngY = " + std::to_string( pngY );
+
+            dirPosition.emplace_back( pngX, pngY );
+            logVerbose << -1;
+        }
+
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + data.PngExtension, pngWidth, pngHeight, true ) );
+
+        PngOutputPlan& plan = plans.back();
+
+        // TODO
+        if( !firstIsAnim )
+        {
+            plan.Preview = true;
+            plan.Frames.emplace_back();
+        }
+
+        const std::size_t firstFrame = plan.Frames.size();
+        plan.Frames.resize( firstFrame + data.Frm.FramesPerDirection );
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            plan.Metadata.Directions.push_back( { dir.Index, dirPosition[dir.Index].first, dirPosition[dir.Index].second, dirSize[dir.Index].first, dirSize[dir.Index].second, dirOffsets[dir.Index].front().first, dirOffsets[dir.Index].front().second } );
+
+            for( const auto& frame : dir.Frames() )
+            {
+                const uint32_t pngX = dirPosition[dir.Index].first + dirOffsets[dir.Index][frame.Index].first;
+                const uint32_t pngY = dirPosition[dir.Index].second + dirOffsets[dir.Index][frame.Index].second;
+
+                plan.Frames[firstFrame + frame.Index].push_back( PlaceFrame( frame, pngX, pngY ) );
+                AddSidecarFrame( plan.Metadata, frame, dir.Index, pngX, pngY );
+            }
+        }
+
+        return plans;
+    }
+
+    // create single raw sprite container with all directions included
+    // default extension is replaced, as file cannot be opened by anything expecting an image
+    // plan stores each direction in metadata, and all frames in single list
+    static std::vector<PngOutputPlan> PlanRaw( const PngGeneratorData& data, Logging& logVerbose )
+    {
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + ( data.PngExtension == OutputFormatExtension( data.Format ) ? ".raw" : data.PngExtension ), 0, 0, false ) );
+
+        PngOutputPlan& plan = plans.back();
+        plan.Frames.emplace_back();
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            uint32_t dirWidth = 0, dirHeight = 0;
+
+            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+            PngOffsets offsets = ConvertOffsets( dir.Frames(), dirWidth, dirHeight, logVerbose );
+            logVerbose << -1;
+
+            plan.Metadata.Directions.push_back( { dir.Index, 0, 0, dirWidth, dirHeight, offsets.front().first, offsets.front().second } );
+
+            for( const auto& frame : dir.Frames() )
+            {
+                plan.Frames.front().push_back( PlaceFrame( frame, offsets[frame.Index].first, offsets[frame.Index].second ) );
+                AddSidecarFrame( plan.Metadata, frame, dir.Index, offsets[frame.Index].first, offsets[frame.Index].second );
+            }
+        }
+
+        return plans;
+    }
+
+    static void WriteRawSprite( const PngGeneratorData& data, const PngOutputPlan& plan, const RawSpritePixelFormat pixelFormat, Logging& logVerbose )
+    {
+        RawSpriteData raw;
+        raw.PixelFormat        = pixelFormat;
+        raw.FramesPerDirection = data.Frm.FramesPerDirection;
+        raw.FramesPerSecond    = GetDelayDen( data.Frm );
+        raw.ActionFrame        = data.Frm.ActionFrame;
+
+        if( pixelFormat == RawSpritePixelFormat::Indexed )
+        {
+            for( const uint8_t* color : data.Palette->Colors )
+                raw.Palette.insert( raw.Palette.end(), color, color + 4 );
+        }
+
+        for( const auto& dir : plan.Metadata.Directions )
+            raw.Directions.push_back( { dir.Width, dir.Height, static_cast<uint32_t>( raw.Directions.size() * data.Frm.FramesPerDirection ), data.Frm.FramesPerDirection } );
+
+        for( const auto& placement : plan.Frames.front() )
+        {
+            const Falltergeist::Format::Frm::Frame& frame = *placement.Frame;
+
+            raw.Frames.push_back( { frame.Width, frame.Height, frame.OffsetX, frame.OffsetY, placement.X, placement.Y, placement.X + frame.Width / 2, placement.Y + frame.Height, 0, 0 } );
+            raw.Pixels.emplace_back();
+
+            std::vector<uint8_t>& pixels = raw.Pixels.back();
+            pixels.reserve( frame.Width * frame.Height * ( pixelFormat == RawSpritePixelFormat::Indexed ? 1 : 4 ) );
+
+            for( uint16_t py = 0; py < frame.Height; py++ )
+            {
+                for( uint16_t px = 0; px < frame.Width; px++ )
+                {
+                    const uint8_t colorIndex = frame.ColorIndex( px, py );
+
+                    if( pixelFormat == RawSpritePixelFormat::Indexed )
+                        pixels.push_back( colorIndex );
+                    else
+                    {
+                        const uint8_t* color = data.Palette->Colors[colorIndex];
+                        pixels.insert( pixels.end(), color, color + 4 );
+                    }
+                }
+            }
+        }
+
+        logVerbose << "write raw = " + plan.Filename + " = " + std::to_string( raw.Directions.size() ) + " directions, " + std::to_string( raw.Frames.size() ) + " frames";
+
+        std::unique_ptr<Sink> sink = CreateFileSink( data.Sinks, plan.Filename );
+        RawSpriteWrite( *sink, raw );
+        AddOutput( data, plan.Filename );
+    }
+
+    static void WriteRaw( const PngGeneratorData& data, const PngOutputPlan& plan, Logging& logVerbose )
+    {
+        WriteRawSprite( data, plan, RawSpritePixelFormat::Indexed, logVerbose );
+    }
+
+    static void WriteRawRgba( const PngGeneratorData& data, const PngOutputPlan& plan, Logging& logVerbose )
+    {
+        WriteRawSprite( data, plan, RawSpritePixelFormat::Rgba, logVerbose );
+    }
+
+    // representative frame of given direction; action frame if there is one
+    static const Falltergeist::Format::Frm::Frame& GetThumbnailFrame( const PngGeneratorData& data, uint8_t dir )
+    {
+        return data.Frm.GetFrame( dir, data.Frm.ActionFrame < data.Frm.FramesPerDirection ? data.Frm.ActionFrame : 0 );
+    }
+
+    // create small image with representative frame, facing south-east if possible
+    static std::vector<PngOutputPlan> PlanThumbnail( const PngGeneratorData& data, Logging& )
+    {
+        const Falltergeist::Format::Frm::Frame& frame = GetThumbnailFrame( data, data.Frm.DirectionsSize() > DIR_SE ? DIR_SE : 0 );
+
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + data.PngExtension, std::max<uint32_t>( 1, frame.Width ), std::max<uint32_t>( 1, frame.Height ), false ) );
+
+        PngOutputPlan& plan = plans.back();
+        plan.Metadata       = Sidecar();
+        plan.Frames.push_back( { PlaceFrame( frame, 0, 0 ) } );
+
+        return plans;
+    }
+
+    // create small image with representative frames of all directions, from left to right, aligned to bottom
+    static std::vector<PngOutputPlan> PlanThumbnailStrip( const PngGeneratorData& data, Logging& )
+    {
+        uint32_t pngWidth = 0, pngHeight = 1;
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            const Falltergeist::Format::Frm::Frame& frame = GetThumbnailFrame( data, dir.Index );
+
+            pngWidth += frame.Width;
+            pngHeight = std::max<uint32_t>( pngHeight, frame.Height );
+        }
+
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, data.PngPath + data.PngBasename + data.PngExtension, std::max<uint32_t>( 1, pngWidth ), pngHeight, false ) );
+
+        PngOutputPlan& plan = plans.back();
+        plan.Metadata       = Sidecar();
+        plan.Frames.emplace_back();
+
+        uint32_t pngX = 0;
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            const Falltergeist::Format::Frm::Frame& frame = GetThumbnailFrame( data, dir.Index );
+
+            plan.Frames.front().push_back( PlaceFrame( frame, pngX, pngHeight - frame.Height ) );
+            pngX += frame.Width;
+        }
+
+        return plans;
+    }
+
+    // thumbnail is downscaled while rows of planned frames are converted to RGBA, without drawing full size image first
+    static void WriteThumbnail( const PngGeneratorData& data, const PngOutputPlan& plan, Logging& logVerbose )
+    {
+        const uint32_t size    = std::max<uint32_t>( 1, data.ThumbnailSize );
+        const uint32_t longest = std::max( plan.Width, plan.Height );
+        uint32_t       width = plan.Width, height = plan.Height;
+
+        if( longest > size )
+        {
+            width  = std::max<uint32_t>( 1, static_cast<uint32_t>( static_cast<uint64_t>( plan.Width ) * size / longest ) );
+            height = std::max<uint32_t>( 1, static_cast<uint32_t>( static_cast<uint64_t>( plan.Height ) * size / longest ) );
+        }
+
+        const uint8_t( &colors )[256][4] = data.Palette->Colors;
+
+        PngDownscaler        scaler( plan.Width, plan.Height, width, height );
+        std::vector<uint8_t> row( plan.Width * 4 );
+
+        for( uint32_t y = 0; y < plan.Height; y++ )
+        {
+            std::fill( row.begin(), row.end(), 0 );
+
+            for( const auto& placement : plan.Frames.front() )
+            {
+                if( y < placement.Y || y >= placement.Y + placement.AreaHeight )
+                    continue;
+
+                const uint16_t frameY = static_cast<uint16_t>( placement.AreaY + y - placement.Y );
+                uint8_t*       out    = &row[placement.X * 4];
+
+                for( uint32_t x = 0; x < placement.AreaWidth; x++, out += 4 )
+                    std::memcpy( out, colors[placement.Frame->ColorIndex( static_cast<uint16_t>( placement.AreaX + x ), frameY )], 4 );
+            }
+
+            scaler.addRow( row.data() );
+        }
+
+        logVerbose << "write thumbnail = " + plan.Filename + " = " + std::to_string( width ) + "x" + std::to_string( height );
+        WriteImage( data, GetPngPalette( data ), *scaler.finish(), plan.Filename, false, logVerbose );
+        AddOutput( data, plan.Filename );
+    }
+
+    // space between atlas sprites
+    static constexpr uint8_t AtlasPadding = 1;
+
+    // key used to find identical frames; frames are identical if visible areas have same size and pixels
+    static std::string AtlasSpriteKey( const Falltergeist::Format::Frm::Frame& frame, uint32_t trimX, uint32_t trimY, uint32_t width, uint32_t height )
+    {
+        std::string key = std::to_string( width ) + "x" + std::to_string( height ) + ":";
+        key.reserve( key.size() + width * height );
+
+        for( uint32_t y = trimY; y < trimY + height; y++ )
+        {
+            for( uint32_t x = trimX; x < trimX + width; x++ )
+                key += static_cast<char>( frame.ColorIndex( x, y ) );
+        }
+
+        return key;
+    }
+
+    // create single image with trimmed frames of all directions packed together, and .json file describing them
+    // identical frames are stored once
+    static std::vector<PngOutputPlan> PlanAtlas( const PngGeneratorData& data, Logging& logVerbose )
+    {
+        const std::string pngName  = data.PngPath + data.PngBasename + data.PngExtension;
+        const std::string jsonName = GetMetadataBasename( data, pngName ) + ".json";
+
+        struct AtlasFrame
+        {
+            const Falltergeist::Format::Frm::Frame* Frame;
+
+            // visible area of frame
+            uint32_t TrimX, TrimY, Width, Height;
+
+            std::size_t Sprite;
+        };
+
+        struct AtlasSprite
+        {
+            uint32_t X, Y;
+        };
+
+        // frames[D][F] = direction D, frame F
+        std::vector<std::vector<AtlasFrame>> frames;
+        std::vector<AtlasSprite>             sprites;
+        std::vector<const AtlasFrame*>       spriteFrame; // first frame using sprite
+
+        // dirOffsets[D][F].first  = direction D, frame F, offset X
+        // dirOffsets[D][F].second = direction D, frame F, offset Y
+        std::vector<PngOffsets>                    dirOffsets;
+        std::vector<std::pair<uint32_t, uint32_t>> dirSize;
+
+        std::unordered_map<std::string, std::size_t> spriteLookup;
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            logVerbose << "direction " + std::to_string( dir.Index ) << 1;
+
+            uint32_t dirWidth = 0, dirHeight = 0;
+            dirOffsets.emplace_back( ConvertOffsets( dir.Frames(), dirWidth, dirHeight, logVerbose ) );
+            dirSize.emplace_back( dirWidth, dirHeight );
+            frames.emplace_back();
+
+            for( const auto& frame : dir.Frames() )
+            {
+                AtlasFrame atlasFrame = { &frame, 0, 0, 0, 0, 0 };
+                TrimFrame( data, frame, atlasFrame.TrimX, atlasFrame.TrimY, atlasFrame.Width, atlasFrame.Height );
+
+                std::string key = AtlasSpriteKey( frame, atlasFrame.TrimX, atlasFrame.TrimY, atlasFrame.Width, atlasFrame.Height );
+
+                auto it = spriteLookup.find( key );
+                if( it == spriteLookup.end() )
+                    it = spriteLookup.emplace( std::move( key ), sprites.size() ).first;
+
+                atlasFrame.Sprite = it->second;
+                frames.back().push_back( atlasFrame );
+
+                if( atlasFrame.Sprite == sprites.size() )
+                {
+                    sprites.push_back( { 0, 0 } );
+                    spriteFrame.push_back( nullptr );
+                }
+
+                logVerbose << "frame:" + std::to_string( frame.Index ) + " trim " + std::to_string( atlasFrame.TrimX ) + "," + std::to_string( atlasFrame.TrimY ) + " -> " + std::to_string( atlasFrame.Width ) + "x" + std::to_string( atlasFrame.Height ) + " sprite:" + std::to_string( atlasFrame.Sprite );
+            }
+
+            logVerbose << -1;
+        }
+
+        // frames vectors are complete, pointers are stable now
+        for( const auto& dirFrames : frames )
+        {
+            for( const auto& frame : dirFrames )
+            {
+                if( !spriteFrame[frame.Sprite] )
+                    spriteFrame[frame.Sprite] = &frame;
+            }
+        }
+
+        // pack sprites, biggest first; bin grows until everything fits
+
+        std::vector<std::size_t> order( sprites.size() );
+        uint64_t                 area = 0;
+        uint32_t                 side = 1;
+
+        for( std::size_t idx = 0; idx < sprites.size(); idx++ )
+        {
+            const AtlasFrame& frame = *spriteFrame[idx];
+
+            order[idx] = idx;
+            area += static_cast<uint64_t>( frame.Width + AtlasPadding ) * ( frame.Height + AtlasPadding );
+            side = std::max( side, std::max( frame.Width, frame.Height ) + AtlasPadding );
+        }
+
+        std::stable_sort( order.begin(), order.end(), [&spriteFrame]( std::size_t a, std::size_t b ) {
+            return std::make_pair( spriteFrame[a]->Height, spriteFrame[a]->Width ) > std::make_pair( spriteFrame[b]->Height, spriteFrame[b]->Width );
+        } );
+
+        while( static_cast<uint64_t>( side ) * side < area )
+            side++;
+
+        uint32_t pngWidth = 1, pngHeight = 1;
+        for( bool packed = false; !packed; side += side / 8 + 1 )
+        {
+            MaxRectsPacker packer( side, side );
+
+            packed = true;
+            for( const std::size_t idx : order )
+            {
+                const AtlasFrame& frame = *spriteFrame[idx];
+
+                if( !packer.insert( frame.Width + ( frame.Width ? AtlasPadding : 0 ), frame.Height + ( frame.Height ? AtlasPadding : 0 ), sprites[idx].X, sprites[idx].Y ) )
+                {
+                    packed = false;
+                    break;
+                }
+            }
+
+            if( packed )
+            {
+                pngWidth  = std::max<uint32_t>( 1, packer.usedWidth() - ( packer.usedWidth() ? AtlasPadding : 0 ) );
+                pngHeight = std::max<uint32_t>( 1, packer.usedHeight() - ( packer.usedHeight() ? AtlasPadding : 0 ) );
+            }
+        }
+
+        logVerbose << "atlas = " + std::to_string( pngWidth ) + "x" + std::to_string( pngHeight ) + ", " + std::to_string( sprites.size() ) + " sprites";
+
+        // .json file replaces sidecar
+        std::vector<PngOutputPlan> plans;
+        plans.push_back( CreatePlan( data, pngName, pngWidth, pngHeight, false ) );
+
+        PngOutputPlan& plan = plans.back();
+        plan.Metadata       = Sidecar();
+        plan.Frames.emplace_back();
+
+        for( std::size_t idx = 0; idx < sprites.size(); idx++ )
+        {
+            const AtlasFrame& frame = *spriteFrame[idx];
+
+            if( frame.Width )
+                plan.Frames.front().push_back( { frame.Frame, frame.TrimX, frame.TrimY, frame.Width, frame.Height, sprites[idx].X, sprites[idx].Y } );
+        }
+
+        // describe frames
+        // hotspot is relative to sprite area, and might be located outside of it
+
+        JsonWriter json;
+        json.beginObject();
+        json.key( "image" ).value( data.PngBasename + data.PngExtension );
+        json.key( "width" ).value( pngWidth );
+        json.key( "height" ).value( pngHeight );
+        json.key( "fps" ).value( GetDelayDen( data.Frm ) );
+        json.key( "actionFrame" ).value( data.Frm.ActionFrame );
+        json.key( "directions" ).beginArray();
+        for( std::size_t dirIdx = 0; dirIdx < frames.size(); dirIdx++ )
+        {
+            json.beginObject();
+            json.key( "width" ).value( dirSize[dirIdx].first );
+            json.key( "height" ).value( dirSize[dirIdx].second );
+            json.key( "frames" ).beginArray();
+            for( const auto& frame : frames[dirIdx] )
+            {
+                const AtlasSprite& sprite = sprites[frame.Sprite];
+                const auto&        offset = dirOffsets[dirIdx][frame.Frame->Index];
+
+                json.beginObject();
+                json.key( "x" ).value( frame.Width ? sprite.X : 0 );
+                json.key( "y" ).value( frame.Height ? sprite.Y : 0 );
+                json.key( "w" ).value( frame.Width );
+                json.key( "h" ).value( frame.Height );
+                json.key( "trimX" ).value( frame.TrimX );
+                json.key( "trimY" ).value( frame.TrimY );
+                json.key( "frameWidth" ).value( frame.Frame->Width );
+                json.key( "frameHeight" ).value( frame.Frame->Height );
+                json.key( "offsetX" ).value( frame.Frame->OffsetX );
+                json.key( "offsetY" ).value( frame.Frame->OffsetY );
+                json.key( "canvasX" ).value( offset.first );
+                json.key( "canvasY" ).value( offset.second );
+                json.key( "hotspotX" ).value( static_cast<int64_t>( frame.Frame->Width / 2 ) - frame.TrimX );
+                json.key( "hotspotY" ).value( static_cast<int64_t>( frame.Frame->Height ) - frame.TrimY );
+                json.endObject();
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+
+        plan.Files.emplace_back( jsonName, json.str() );
+
+        return plans;
+    }
+
+    //
+    // batch atlas
+    //
+
+    AtlasBatch::AtlasBatch( uint32_t pageWidth, uint32_t pageHeight, uint32_t maxPages /* = 0 */ ) :
+        _pageWidth( pageWidth ),
+        _pageHeight( pageHeight ),
+        _maxPages( maxPages )
+    {
+        if( pageWidth <= AtlasPadding || pageHeight <= AtlasPadding )
+            throw std::runtime_error( "AtlasBatch::AtlasBatch() - Invalid page size" );
+    }
+
+    AtlasBatch::~AtlasBatch()
+    {}
+
+    void AtlasBatch::add( const std::string& name, const PngGeneratorData& data, Logging& logVerbose )
+    {
+        if( !_output )
+        {
+            _output.reset( new PngGeneratorOutput( data ) );
+            _palette.reset( new PngPalette( GetPngPalette( data ) ) );
+        }
+
+        _files.push_back( { name, GetDelayDen( data.Frm ), data.Frm.ActionFrame, {} } );
+        File& file = _files.back();
+
+        for( const auto& dir : data.Frm.Directions() )
+        {
+            file.Frames.emplace_back();
+
+            for( const auto& frm : dir.Frames() )
+            {
+                Frame frame = { 0, 0, 0, 0, 0, frm.Width, frm.Height, frm.OffsetX, frm.OffsetY };
+                TrimFrame( data, frm, frame.TrimX, frame.TrimY, frame.Width, frame.Height );
+
+                std::string key = AtlasSpriteKey( frm, frame.TrimX, frame.TrimY, frame.Width, frame.Height );
+
+                auto it = _spriteLookup.find( key );
+                if( it == _spriteLookup.end() )
+                {
+                    it = _spriteLookup.emplace( std::move( key ), _sprites.size() ).first;
+                    _sprites.push_back( { nullptr, 0, 0, 0 } );
+
+                    // only visible area is kept, .frm can be released as soon as function returns
+                    if( frame.Width )
+                    {
+                        _sprites.back().Image.reset( new PngImage( frame.Width, frame.Height ) );
+                        DrawFrameArea( data, frm, *_sprites.back().Image, 0, 0, frame.TrimX, frame.TrimY, frame.Width, frame.Height, logVerbose );
+                    }
+                }
+
+                frame.Sprite = it->second;
+                file.Frames.back().push_back( frame );
+            }
+        }
+
+        logVerbose << "batch atlas = " + name + ", " + std::to_string( _sprites.size() ) + " sprites";
+    }
+
+    void AtlasBatch::write( const std::string& basename, Logging& logVerbose )
+    {
+        if( !_output )
+            throw std::runtime_error( "AtlasBatch::write() - No files added" );
+
+        // pack sprites, biggest first; each sprite goes to first page with enough space
+
+        std::vector<std::size_t> order;
+        for( std::size_t idx = 0; idx < _sprites.size(); idx++ )
+        {
+            const PngImage* image = _sprites[idx].Image.get();
+
+            if( !image )
+                continue;
+
+            if( image->width() + AtlasPadding > _pageWidth || image->height() + AtlasPadding > _pageHeight )
+                throw std::runtime_error( "AtlasBatch::write() - Frame " + std::to_string( image->width() ) + "x" + std::to_string( image->height() ) + " does not fit in page " + std::to_string( _pageWidth ) + "x" + std::to_string( _pageHeight ) );
+
+            order.push_back( idx );
+        }
+
+        std::stable_sort( order.begin(), order.end(), [this]( std::size_t a, std::size_t b ) {
+            const PngImage& imageA = *_sprites[a].Image;
+            const PngImage& imageB = *_sprites[b].Image;
+
+            return std::make_pair( imageA.height(), imageA.width() ) > std::make_pair( imageB.height(), imageB.width() );
+        } );
+
+        std::vector<MaxRectsPacker> pages;
+        for( const std::size_t idx : order )
+        {
+            Sprite& sprite = _sprites[idx];
+
+            uint32_t page = 0;
+            while( page < pages.size() && !pages[page].insert( sprite.Image->width() + AtlasPadding, sprite.Image->height() + AtlasPadding, sprite.X, sprite.Y ) )
+                page++;
+
+            if( page == pages.size() )
+            {
+                if( _maxPages && pages.size() == _maxPages )
+                    throw std::runtime_error( "AtlasBatch::write() - Frames don't fit in " + std::to_string( _maxPages ) + " pages" );
+
+                pages.emplace_back( _pageWidth, _pageHeight );
+                pages.back().insert( sprite.Image->width() + AtlasPadding, sprite.Image->height() + AtlasPadding, sprite.X, sprite.Y );
+            }
+
+            sprite.Page = page;
+        }
+
+        // pages
+
+        const std::string            extension = OutputFormatExtension( _output->Format );
+        const std::string::size_type slash     = basename.find_last_of( '/' );
+        const std::string            name      = slash == std::string::npos ? basename : basename.substr( slash + 1 );
+
+        JsonWriter json;
+        json.beginObject();
+        json.key( "pages" ).beginArray();
+
+        for( uint32_t page = 0; page < pages.size(); page++ )
+        {
+            const std::string pageName = basename + "_" + std::to_string( page ) + extension;
+
+            logVerbose << "write page = " + pageName + " = " + std::to_string( _pageWidth ) + "x" + std::to_string( _pageHeight );
+
+            PngImage image( _pageWidth, _pageHeight );
+            for( const auto& sprite : _sprites )
+            {
+                if( !sprite.Image || sprite.Page != page )
+                    continue;
+
+                for( uint32_t y = 0; y < sprite.Image->height(); y++ )
+                    std::memcpy( image.rows()[sprite.Y + y] + sprite.X * 4, sprite.Image->rows()[y], sprite.Image->width() * 4 );
+            }
+
+            WriteImage( *_output, *_palette, image, pageName, true, logVerbose );
+
+            json.beginObject();
+            json.key( "image" ).value( name + "_" + std::to_string( page ) + extension );
+            json.key( "width" ).value( _pageWidth );
+            json.key( "height" ).value( _pageHeight );
+            json.endObject();
+        }
+
+        json.endArray();
+
+        // index
+
+        json.key( "files" ).beginArray();
+        for( const auto& file : _files )
+        {
+            json.beginObject();
+            json.key( "file" ).value( file.Name );
+            json.key( "fps" ).value( file.FramesPerSecond );
+            json.key( "actionFrame" ).value( file.ActionFrame );
+            json.key( "directions" ).beginArray();
+            for( const auto& dirFrames : file.Frames )
+            {
+                json.beginObject();
+                json.key( "frames" ).beginArray();
+                for( const auto& frame : dirFrames )
+                {
+                    const Sprite& sprite = _sprites[frame.Sprite];
+
+                    json.beginObject();
+                    json.key( "page" ).value( sprite.Page );
+                    json.key( "x" ).value( sprite.X );
+                    json.key( "y" ).value( sprite.Y );
+                    json.key( "w" ).value( frame.Width );
+                    json.key( "h" ).value( frame.Height );
+                    json.key( "trimX" ).value( frame.TrimX );
+                    json.key( "trimY" ).value( frame.TrimY );
+                    json.key( "frameWidth" ).value( frame.FrameWidth );
+                    json.key( "frameHeight" ).value( frame.FrameHeight );
+                    json.key( "offsetX" ).value( frame.OffsetX );
+                    json.key( "offsetY" ).value( frame.OffsetY );
+                    json.key( "hotspotX" ).value( static_cast<int64_t>( frame.FrameWidth / 2 ) - frame.TrimX );
+                    json.key( "hotspotY" ).value( static_cast<int64_t>( frame.FrameHeight ) - frame.TrimY );
+                    json.endObject();
+                }
+                json.endArray();
+                json.endObject();
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+
+        logVerbose << "write json = " + basename + ".json";
+        WriteText( *_output, basename + ".json", json.str() );
+    }
+
+    //
+    // used by main application
+    //
+
+    std::unordered_map<std::string, PngGeneratorInfo> Generator;
+
+    void InitPngGenerators()
+    {
+        Generator["legacy"]          = { PngGeneratorSupportsIndexed, &PlanLegacy, nullptr };
+        Generator["static"]          = { PngGeneratorSupportsIndexed, &PlanStatic, nullptr };
+        Generator["anim"]            = { PngGeneratorPerDirection | PngGeneratorSupportsIndexed, &PlanAnim, nullptr };
+        Generator["anim-packed"]     = { PngGeneratorSupportsIndexed, &PlanAnimPacked, nullptr };
+        Generator["atlas"]           = { PngGeneratorSupportsIndexed, &PlanAtlas, nullptr };
+        Generator["raw"]             = { PngGeneratorSupportsIndexed, &PlanRaw, &WriteRaw };
+        Generator["raw-rgba"]        = { 0, &PlanRaw, &WriteRawRgba };
+        Generator["thumbnail"]       = { 0, &PlanThumbnail, &WriteThumbnail };
+        Generator["thumbnail-strip"] = { 0, &PlanThumbnailStrip, &WriteThumbnail };
+    }
+
+    static std::vector<PngOutputPlan> PlanPngGenerator( const PngGeneratorInfo& generator, const PngGeneratorData& data, Logging& logVerbose )
+    {
+        logVerbose << "plan" << 1;
+        std::vector<PngOutputPlan> plans = generator.Plan( data, logVerbose );
+        logVerbose << -1;
+
+        return plans;
+    }
+
+    // each planned output is rendered, encoded and written
+    static void WritePngGenerator( const PngGeneratorInfo& generator, const PngGeneratorData& data, const std::vector<PngOutputPlan>& plans, Logging& logVerbose )
+    {
+        const bool indexed = ( generator.Capabilities & PngGeneratorSupportsIndexed ) != 0;
+
+        auto write = [&generator, &data, indexed]( const PngOutputPlan& plan, Logging& log ) {
+            if( generator.Write )
+                generator.Write( data, plan, log );
+            else
+                WriteOutput( data, plan, indexed, log );
+        };
+
+        if( !data.Pool || plans.size() < 2 || !( generator.Capabilities & PngGeneratorPerDirection ) )
+        {
+            for( const auto& plan : plans )
+                write( plan, logVerbose );
+
+            return;
+        }
+
+        // independent outputs are written at the same time; messages are cached and printed in original order
+        std::vector<std::unique_ptr<Logging>> logs;
+        std::vector<std::future<void>>        tasks;
+
+        for( const auto& plan : plans )
+        {
+            logs.emplace_back( new Logging( logVerbose.Enabled, true, logVerbose.Indent ) );
+
+            Logging* log = logs.back().get();
+            tasks.push_back( data.Pool->submit( [&write, &plan, log]() { write( plan, *log ); } ) );
+        }
+
+        for( auto& task : tasks )
+            data.Pool->ready( task );
+
+        for( std::size_t idx = 0; idx < tasks.size(); idx++ )
+        {
+            logVerbose.Replay( *logs[idx] );
+            tasks[idx].get();
+        }
+    }
+
+    // plan stage runs first, then each output is rendered, encoded and written
+    void RunPngGenerator( const PngGeneratorInfo& generator, const PngGeneratorData& data, Logging& logVerbose )
+    {
+        WritePngGenerator( generator, data, PlanPngGenerator( generator, data, logVerbose ), logVerbose );
+    }
+
+    void RunPngGenerators( PngGeneratorData& data, const std::vector<std::string>& names, const std::vector<OutputFormat>& formats, Logging& logVerbose )
+    {
+        // select generators
+
+        std::vector<std::string> generators;
+        for( std::string generator : names )
+        {
+            if( generator == "auto" )
+            {
+                if( data.Frm.DirectionsSize() == 1 )
+                {
+                    if( data.Frm.FramesPerDirection == 1 )
+                        generator = "legacy";
+                    else
+                        generator = "anim";
+                }
+                else
+                    generator = "anim";
+
+                logVerbose << "selected generator = " + generator;
+            }
+            else
+                logVerbose << "preselected generator = " + generator;
+
+            if( Generator.find( generator ) == Generator.end() )
+                throw std::runtime_error( "RunPngGenerators() - Unknown generator: " + generator );
+
+            if( std::find( generators.begin(), generators.end(), generator ) == generators.end() )
+                generators.push_back( generator );
+        }
+
+        // run all generators in all formats, using same .frm data
+        // everything is planned first, so render cache knows which frames are drawn more than once, and when they're not needed anymore
+
+        const std::string pngBasename  = data.PngBasename;
+        const std::string pngExtension = data.PngExtension;
+
+        auto select = [&data, &formats, &generators, &pngBasename, &pngExtension]( std::size_t format, std::size_t generator ) {
+            data.Format          = formats[format];
+            data.MultipleFormats = formats.size() > 1;
+            data.PngExtension    = formats.size() > 1 ? OutputFormatExtension( formats[format] ) : pngExtension;
+            data.PngBasename     = generators.size() > 1 ? pngBasename + "_" + generators[generator] : pngBasename;
+        };
+
+        std::vector<std::vector<PngOutputPlan>> plans;
+
+        for( std::size_t format = 0; format < formats.size(); format++ )
+        {
+            for( std::size_t generator = 0; generator < generators.size(); generator++ )
+            {
+                select( format, generator );
+                logVerbose << "generator = " + generators[generator] << 1;
+                plans.push_back( PlanPngGenerator( Generator.at( generators[generator] ), data, logVerbose ) );
+                logVerbose << -1;
+            }
+        }
+
+        PngRenderCache renderCache;
+
+        if( plans.size() > 1 )
+        {
+            for( std::size_t run = 0; run < plans.size(); run++ )
+            {
+                if( Generator.at( generators[run % generators.size()] ).Write )
+                    continue;
+
+                for( const auto& plan : plans[run] )
+                    PlanRenderCache( data, plan, renderCache );
+            }
+
+            renderCache.prune();
+            data.RenderCache = &renderCache;
+        }
+
+        for( std::size_t format = 0; format < formats.size(); format++ )
+        {
+            for( std::size_t generator = 0; generator < generators.size(); generator++ )
+            {
+                select( format, generator );
+
+                logVerbose << "start generator = " + generators[generator] << 1;
+                WritePngGenerator( Generator.at( generators[generator] ), data, plans[format * generators.size() + generator], logVerbose );
+                logVerbose << -1 << "end generator = " + generators[generator];
+            }
+        }
+
+        data.PngBasename     = pngBasename;
+        data.PngExtension    = pngExtension;
+        data.MultipleFormats = false;
+        data.RenderCache     = nullptr;
     }
 }
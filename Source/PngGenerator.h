@@ -23,24 +23,119 @@
 #pragma once
 
 // c++ includes
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 // frm2png includes
 #include "Logging.h"
+#include "PaletteTable.h"
+#include "PngEncoder.h"
+#include "PngImage.h"
+#include "PngPalette.h"
+#include "Sidecar.h"
+#include "Sink.h"
+#include "ThreadPool.h"
 
 // falltergeist includes
 #include "Format/Frm/File.h"
-#include "Format/Pal/File.h"
 
 namespace frm2png
 {
-    struct PngGeneratorData
+    enum class OutputFormat : uint8_t
     {
-        Falltergeist::Format::Frm::File Frm;
-        Falltergeist::Format::Pal::File Pal;
+        Png,
+        Qoi,      // animations are stored as sprite sheet
+        QoiFrames // animations are stored as sequence of files
+    };
+
+    bool OutputFormatFromString( const std::string& name, OutputFormat& format );
+    // default extension of output files, including dot
+    std::string OutputFormatExtension( OutputFormat format );
+
+    // how generators write files
+    struct PngGeneratorOutput
+    {
+        OutputFormat Format = OutputFormat::Png;
+
+        // APNG frames store only area changed since previous frame
+        bool AnimDelta = false;
+
+        // if set, images are encoded by frm2png rather than libpng, and APNG frames are compressed in parallel
+        ThreadPool*        Pool = nullptr;
+        PngEncoderSettings Encoder;
+
+        // if non-zero, images are encoded with that many settings combinations and smallest result is used
+        unsigned Optimize = 0;
+
+        // describes placement of frames in each image
+        SidecarFormat Metadata = SidecarFormat::None;
+
+        // longest side of images created by 'thumbnail' generators
+        uint32_t ThumbnailSize = 64;
+
+        // if set, creates sinks for output files instead of writing them to disk
+        SinkFactory* Sinks = nullptr;
+    };
+
+    // frames drawn for one output, reused by other outputs of same .frm file with identical layout
+    // used when multiple generators or formats are selected; only frames planned for more than one output are kept,
+    // and each is dropped as soon as its last planned user is done with it
+    class PngRenderCache
+    {
+    protected:
+        struct Entry
+        {
+            std::unique_ptr<PngImage> Image;
+            std::size_t               Uses = 0;
+        };
+
+        std::mutex                             _lock;
+        std::unordered_map<std::string, Entry> _images;
+
+    public:
+        // counts planned use of frame; must be called for all outputs before anything is drawn
+        void plan( const std::string& key );
+
+        // forgets frames planned only once
+        void prune();
+
+        // returns true if frame is kept in cache
+        bool shared( const std::string& key );
+
+        // returns nullptr if image is not drawn yet
+        const PngImage* find( const std::string& key );
+
+        // if image with same key has been added by another thread in meantime, that image is kept and returned
+        const PngImage& insert( const std::string& key, std::unique_ptr<PngImage> image );
+
+        // called by each planned user when it doesn't need image anymore
+        void release( const std::string& key );
+    };
+
+    // names of files written for one .frm file, in order of completion
+    class PngOutputList
+    {
+    protected:
+        std::mutex               _lock;
+        std::vector<std::string> _files;
+
+    public:
+        void add( const std::string& filename );
+
+        std::vector<std::string> files();
+    };
+
+    struct PngGeneratorData : public PngGeneratorOutput
+    {
+        Falltergeist::Format::Frm::File     Frm;
+        std::shared_ptr<const PaletteTable> Palette;
 
         uint8_t RgbMultiplier = 0;
 
@@ -48,12 +143,125 @@ namespace frm2png
         std::string PngBasename;
         std::string PngExtension;
 
-        PngGeneratorData( Falltergeist::Format::Frm::File&& frm, Falltergeist::Format::Pal::File&& pal );
+        // set when more than one format is written; metadata files keep image extension then (name.png.json), so each format has its own
+        bool MultipleFormats = false;
+
+        // if set, rendered frames are shared between generators
+        PngRenderCache* RenderCache = nullptr;
+
+        // if set, receives names of all written files
+        PngOutputList* Outputs = nullptr;
+
+        PngGeneratorData( Falltergeist::Format::Frm::File&& frm, std::shared_ptr<const PaletteTable> palette );
     };
 
-    typedef std::function<void( const PngGeneratorData&, Logging& )> PngGeneratorFunc;
+    // packs frames of many .frm files into shared images of fixed size ('pages'), and writes .json index describing them
+    // frames are collected by add(), packing happens in write()
+    class AtlasBatch
+    {
+    protected:
+        struct Sprite
+        {
+            std::unique_ptr<PngImage> Image;
+            uint32_t                  Page, X, Y;
+        };
+
+        struct Frame
+        {
+            std::size_t Sprite;
+            uint32_t    TrimX, TrimY, Width, Height;
+            uint16_t    FrameWidth, FrameHeight;
+            int16_t     OffsetX, OffsetY;
+        };
+
+        struct File
+        {
+            std::string Name;
+            uint16_t    FramesPerSecond, ActionFrame;
+
+            // Frames[D][F] = direction D, frame F
+            std::vector<std::vector<Frame>> Frames;
+        };
+
+        uint32_t _pageWidth, _pageHeight;
+        uint32_t _maxPages;
+
+        // settings of first added file are used for all pages
+        std::unique_ptr<PngGeneratorOutput> _output;
+        std::unique_ptr<PngPalette>         _palette;
+
+        std::vector<File>                            _files;
+        std::vector<Sprite>                          _sprites;
+        std::unordered_map<std::string, std::size_t> _spriteLookup;
+
+    public:
+        // write() fails if frames don't fit in maxPages pages; 0 means no limit
+        AtlasBatch( uint32_t pageWidth, uint32_t pageHeight, uint32_t maxPages = 0 );
+        ~AtlasBatch();
+
+        void add( const std::string& name, const PngGeneratorData& data, Logging& logVerbose );
+
+        // writes pages as 'basename_P.ext' and index as 'basename.json'
+        void write( const std::string& basename, Logging& logVerbose );
+    };
+
+    // part of .frm frame drawn at given position of output image
+    struct PngPlacement
+    {
+        const Falltergeist::Format::Frm::Frame* Frame;
+        uint32_t                                AreaX, AreaY, AreaWidth, AreaHeight;
+        uint32_t                                X, Y;
+    };
+
+    // single file created by generator
+    struct PngOutputPlan
+    {
+        std::string Filename;
+        uint32_t    Width = 0, Height = 0;
 
-    extern std::unordered_map<std::string, PngGeneratorFunc> Generator;
+        // if set, each entry of Frames is written as separate APNG frame
+        bool Animated = false;
+
+        // if set, first frame is hidden default image of APNG
+        bool Preview = false;
+
+        // Frames[N] = placements drawn on frame N
+        std::vector<std::vector<PngPlacement>> Frames;
+
+        // written as sidecar file if Metadata.Image is set
+        Sidecar Metadata;
+
+        // additional text files written next to image; filename + content
+        std::vector<std::pair<std::string, std::string>> Files;
+    };
+
+    enum PngGeneratorCapability : uint32_t
+    {
+        // outputs don't depend on each other and can be written at the same time
+        PngGeneratorPerDirection = 1 << 0,
+        // outputs can be written as paletted images
+        PngGeneratorSupportsIndexed = 1 << 1
+    };
+
+    typedef std::function<std::vector<PngOutputPlan>( const PngGeneratorData&, Logging& )> PngGeneratorPlanFunc;
+    typedef std::function<void( const PngGeneratorData&, const PngOutputPlan&, Logging& )> PngGeneratorWriteFunc;
+
+    // generators only decide how frames are arranged (plan); drawing, encoding and writing files is shared by all of them
+    struct PngGeneratorInfo
+    {
+        uint32_t             Capabilities;
+        PngGeneratorPlanFunc Plan;
+
+        // if set, used instead of default render/encode stages (non-image outputs)
+        PngGeneratorWriteFunc Write;
+    };
+
+    extern std::unordered_map<std::string, PngGeneratorInfo> Generator;
 
     void InitPngGenerators();
+    void RunPngGenerator( const PngGeneratorInfo& generator, const PngGeneratorData& data, Logging& logVerbose );
+
+    // runs each generator in each format; 'auto' selects generator matching .frm content
+    // if there's more than one run, outputs of each generator get its name as suffix, other formats use their own extension, and rendered frames are shared
+    void RunPngGenerators( PngGeneratorData& data, const std::vector<std::string>& generators, const std::vector<OutputFormat>& formats, Logging& logVerbose );
 }
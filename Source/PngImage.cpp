@@ -23,6 +23,7 @@
 
 // C++ standard includes
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include <string>
 
@@ -49,6 +50,18 @@ namespace frm2png
         }
     }
 
+    PngImage::PngImage( const PngImage& other, uint32_t x, uint32_t y, uint32_t width, uint32_t height ) :
+        PngImage( width, height )
+    {
+        if( x + width > other._width || y + height > other._height )
+            throw std::runtime_error( "PngImage::PngImage() - Invalid area " + std::to_string( x ) + "," + std::to_string( y ) + " " + std::to_string( width ) + "x" + std::to_string( height ) + " : " + std::to_string( other._width ) + "," + std::to_string( other._height ) );
+
+        for( uint32_t row = 0; row != _height; ++row )
+        {
+            std::memcpy( _rows[row], other._rows[y + row] + x * 4, _width * 4 );
+        }
+    }
+
     PngImage::~PngImage()
     {
         for( uint32_t y = 0; y != _height; ++y )
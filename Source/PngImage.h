@@ -39,6 +39,10 @@ namespace frm2png
     {
     public:
         PngImage( uint32_t width, uint32_t height );
+        // copy of given area of other image
+        PngImage( const PngImage& other, uint32_t x, uint32_t y, uint32_t width, uint32_t height );
+        PngImage( const PngImage& ) = delete;
+        PngImage& operator=( const PngImage& ) = delete;
         ~PngImage();
 
         void setPixel( uint32_t x, uint32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t alpha = 255 );
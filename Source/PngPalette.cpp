@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// frm2png includes
+#include "PngImage.h"
+#include "PngPalette.h"
+
+namespace frm2png
+{
+    static inline uint32_t Pack( uint8_t r, uint8_t g, uint8_t b, uint8_t a )
+    {
+        return ( static_cast<uint32_t>( r ) << 24 ) | ( static_cast<uint32_t>( g ) << 16 ) | ( static_cast<uint32_t>( b ) << 8 ) | a;
+    }
+
+    void PngPalette::add( uint8_t r, uint8_t g, uint8_t b, uint8_t a )
+    {
+        if( _colors.size() >= 256 )
+            throw std::runtime_error( "PngPalette::add() - Too many colors" );
+
+        const uint32_t color = Pack( r, g, b, a );
+
+        _lookup.emplace( color, static_cast<uint8_t>( _colors.size() ) );
+        _colors.push_back( color );
+    }
+
+    std::size_t PngPalette::size() const
+    {
+        return _colors.size();
+    }
+
+    bool PngPalette::find( const uint8_t* rgba, uint8_t& index ) const
+    {
+        auto it = _lookup.find( Pack( rgba[0], rgba[1], rgba[2], rgba[3] ) );
+        if( it == _lookup.end() )
+            return false;
+
+        index = it->second;
+
+        return true;
+    }
+
+    bool PngPalette::convert( const PngImage& image, std::vector<uint8_t>& indexes ) const
+    {
+        indexes.resize( static_cast<std::size_t>( image.width() ) * image.height() );
+
+        uint8_t* out = indexes.data();
+        for( uint32_t y = 0; y < image.height(); y++ )
+        {
+            const uint8_t* row = image.rows()[y];
+
+            // neighbouring pixels are often the same, skip lookup for them
+            uint32_t last      = 0;
+            uint8_t  lastIndex = 0;
+            bool     lastValid = false;
+
+            for( uint32_t x = 0; x < image.width(); x++, row += 4 )
+            {
+                const uint32_t color = Pack( row[0], row[1], row[2], row[3] );
+
+                if( !lastValid || color != last )
+                {
+                    if( !find( row, lastIndex ) )
+                        return false;
+
+                    last      = color;
+                    lastValid = true;
+                }
+
+                *out++ = lastIndex;
+            }
+        }
+
+        return true;
+    }
+
+    std::vector<uint8_t> PngPalette::plte() const
+    {
+        std::vector<uint8_t> result;
+
+        for( uint32_t color : _colors )
+        {
+            result.push_back( static_cast<uint8_t>( color >> 24 ) );
+            result.push_back( static_cast<uint8_t>( color >> 16 ) );
+            result.push_back( static_cast<uint8_t>( color >> 8 ) );
+        }
+
+        return result;
+    }
+
+    std::vector<uint8_t> PngPalette::trns() const
+    {
+        std::vector<uint8_t> result;
+
+        for( uint32_t color : _colors )
+        {
+            result.push_back( static_cast<uint8_t>( color ) );
+        }
+
+        // trailing opaque entries can be omitted
+        while( !result.empty() && result.back() == 255 )
+            result.pop_back();
+
+        return result;
+    }
+
+    bool PngPalette::fromImage( const PngImage& image, PngPalette& palette )
+    {
+        palette = PngPalette();
+
+        for( uint32_t y = 0; y < image.height(); y++ )
+        {
+            const uint8_t* row = image.rows()[y];
+            uint8_t        index;
+
+            for( uint32_t x = 0; x < image.width(); x++, row += 4 )
+            {
+                if( palette.find( row, index ) )
+                    continue;
+                if( palette.size() == 256 )
+                    return false;
+
+                palette.add( row[0], row[1], row[2], row[3] );
+            }
+        }
+
+        return true;
+    }
+}
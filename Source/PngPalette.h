@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// frm2png includes
+#include "PngImage.h"
+
+namespace frm2png
+{
+    // colors of indexed images
+    class PngPalette
+    {
+    protected:
+        std::vector<uint32_t>                 _colors;
+        std::unordered_map<uint32_t, uint8_t> _lookup;
+
+    public:
+        // adds color at next free index; duplicated colors are resolved to first index
+        void add( uint8_t r, uint8_t g, uint8_t b, uint8_t a );
+
+        std::size_t size() const;
+
+        // finds index of RGBA pixel
+        bool find( const uint8_t* rgba, uint8_t& index ) const;
+
+        // converts RGBA image to indexes; returns false if image uses colors not present in palette
+        bool convert( const PngImage& image, std::vector<uint8_t>& indexes ) const;
+
+        // PLTE/tRNS chunks data; tRNS is empty if all colors are opaque
+        std::vector<uint8_t> plte() const;
+        std::vector<uint8_t> trns() const;
+
+        // creates palette from colors used by image; returns false if image uses more than 256 colors
+        static bool fromImage( const PngImage& image, PngPalette& palette );
+    };
+}
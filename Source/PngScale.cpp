@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "PngImage.h"
+#include "PngScale.h"
+#include "ThreadPool.h"
+
+// falltergeist includes
+#include "Format/Frm/Direction.h"
+#include "Format/Frm/File.h"
+#include "Format/Frm/Frame.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#    define FRM2PNG_SSE2
+#    include <emmintrin.h>
+#endif
+
+namespace frm2png
+{
+    // source and output pixels are measured in common units; source pixel is dstSize units long, output pixel is srcSize units long
+    // as output is never bigger than source, each source pixel is split between at most two output pixels
+
+    PngDownscaler::PngDownscaler( uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight ) :
+        _srcWidth( srcWidth ),
+        _srcHeight( srcHeight ),
+        _dstWidth( dstWidth ),
+        _dstHeight( dstHeight ),
+        _column( srcWidth ),
+        _columnWeight( srcWidth ),
+        _row( dstWidth * 4 ),
+        _sum( dstWidth * 4 ),
+        _image( new PngImage( dstWidth, dstHeight ) )
+    {
+        if( !srcWidth || !srcHeight || !dstWidth || !dstHeight || dstWidth > srcWidth || dstHeight > srcHeight )
+            throw std::runtime_error( "PngDownscaler::PngDownscaler() - Invalid size" );
+
+        for( uint32_t x = 0; x < srcWidth; x++ )
+        {
+            const uint64_t start = static_cast<uint64_t>( x ) * dstWidth;
+
+            _column[x]       = static_cast<uint32_t>( start / srcWidth );
+            _columnWeight[x] = static_cast<uint32_t>( std::min<uint64_t>( start + dstWidth, static_cast<uint64_t>( _column[x] + 1 ) * srcWidth ) - start );
+        }
+    }
+
+    void PngDownscaler::addRow( const uint8_t* rgba )
+    {
+        if( _srcY >= _srcHeight )
+            throw std::runtime_error( "PngDownscaler::addRow() - Too many rows" );
+
+        std::fill( _row.begin(), _row.end(), 0 );
+
+        for( uint32_t x = 0; x < _srcWidth; x++, rgba += 4 )
+        {
+            const uint64_t alpha = rgba[3];
+
+            if( !alpha )
+                continue;
+
+            const uint64_t pixel[4] = { rgba[0] * alpha, rgba[1] * alpha, rgba[2] * alpha, alpha };
+            const uint32_t weight   = _columnWeight[x];
+            uint64_t*      out      = &_row[_column[x] * 4];
+
+            for( uint8_t c = 0; c < 4; c++ )
+                out[c] += pixel[c] * weight;
+
+            if( weight < _dstWidth )
+            {
+                for( uint8_t c = 0; c < 4; c++ )
+                    out[4 + c] += pixel[c] * ( _dstWidth - weight );
+            }
+        }
+
+        // same split as columns, applied to rows
+        const uint64_t start  = static_cast<uint64_t>( _srcY ) * _dstHeight;
+        const uint64_t end    = static_cast<uint64_t>( _dstY + 1 ) * _srcHeight;
+        const uint64_t weight = std::min<uint64_t>( start + _dstHeight, end ) - start;
+
+        for( std::size_t idx = 0; idx < _sum.size(); idx++ )
+            _sum[idx] += _row[idx] * weight;
+
+        if( start + _dstHeight >= end )
+        {
+            writeRow();
+
+            for( std::size_t idx = 0; idx < _sum.size(); idx++ )
+                _sum[idx] = _row[idx] * ( _dstHeight - weight );
+        }
+
+        _srcY++;
+    }
+
+    std::unique_ptr<PngImage> PngDownscaler::finish()
+    {
+        if( _srcY != _srcHeight || !_image )
+            throw std::runtime_error( "PngDownscaler::finish() - Image is not complete" );
+
+        return std::move( _image );
+    }
+
+    void PngDownscaler::writeRow()
+    {
+        // each output pixel covers srcWidth * srcHeight units
+        const uint64_t area = static_cast<uint64_t>( _srcWidth ) * _srcHeight;
+        png_bytep      out  = _image->rows()[_dstY];
+
+        for( uint32_t x = 0; x < _dstWidth; x++, out += 4 )
+        {
+            const uint64_t* sum = &_sum[x * 4];
+
+            if( !sum[3] )
+            {
+                std::fill( out, out + 4, 0 );
+                continue;
+            }
+
+            for( uint8_t c = 0; c < 3; c++ )
+                out[c] = static_cast<uint8_t>( ( sum[c] + sum[3] / 2 ) / sum[3] );
+
+            out[3] = static_cast<uint8_t>( ( sum[3] + area / 2 ) / area );
+        }
+
+        _dstY++;
+    }
+
+    //
+    // Scale2x / Scale3x
+    //
+    // rows are processed with one index of padding on each side, so neighbours of edge pixels are always available
+    // vectorized loops handle 16 pixels in each step, scalar loops handle remaining tail
+    //
+
+#ifdef FRM2PNG_SSE2
+    static inline __m128i Load( const uint8_t* data )
+    {
+        return _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+    }
+
+    static inline void Store( uint8_t* data, __m128i value )
+    {
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( data ), value );
+    }
+
+    // mask ? a : b
+    static inline __m128i Select( __m128i mask, __m128i a, __m128i b )
+    {
+        return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+    }
+
+    // a != b
+    static inline __m128i NotEqual( __m128i a, __m128i b )
+    {
+        return _mm_andnot_si128( _mm_cmpeq_epi8( a, b ), _mm_set1_epi8( -1 ) );
+    }
+#endif
+
+    //  B
+    // DEF -> E0 E1
+    //  H     E2 E3
+    static void Scale2xRow( const uint8_t* up, const uint8_t* row, const uint8_t* down, uint32_t width, uint8_t* out0, uint8_t* out1 )
+    {
+        uint32_t x = 0;
+
+#ifdef FRM2PNG_SSE2
+        for( ; x + 16 <= width; x += 16 )
+        {
+            const __m128i b = Load( up + x ), d = Load( row + x - 1 ), e = Load( row + x ), f = Load( row + x + 1 ), h = Load( down + x );
+            const __m128i edge = _mm_and_si128( NotEqual( b, h ), NotEqual( d, f ) );
+
+            const __m128i e0 = Select( _mm_and_si128( edge, _mm_cmpeq_epi8( d, b ) ), d, e );
+            const __m128i e1 = Select( _mm_and_si128( edge, _mm_cmpeq_epi8( b, f ) ), f, e );
+            const __m128i e2 = Select( _mm_and_si128( edge, _mm_cmpeq_epi8( d, h ) ), d, e );
+            const __m128i e3 = Select( _mm_and_si128( edge, _mm_cmpeq_epi8( h, f ) ), f, e );
+
+            Store( out0 + x * 2, _mm_unpacklo_epi8( e0, e1 ) );
+            Store( out0 + x * 2 + 16, _mm_unpackhi_epi8( e0, e1 ) );
+            Store( out1 + x * 2, _mm_unpacklo_epi8( e2, e3 ) );
+            Store( out1 + x * 2 + 16, _mm_unpackhi_epi8( e2, e3 ) );
+        }
+#endif
+
+        for( ; x < width; x++ )
+        {
+            const uint8_t* r = row + x;
+            const uint8_t  b = up[x], d = r[-1], e = r[0], f = r[1], h = down[x];
+            uint8_t*       o0 = out0 + x * 2;
+            uint8_t*       o1 = out1 + x * 2;
+
+            if( b != h && d != f )
+            {
+                o0[0] = d == b ? d : e;
+                o0[1] = b == f ? f : e;
+                o1[0] = d == h ? d : e;
+                o1[1] = h == f ? f : e;
+            }
+            else
+                o0[0] = o0[1] = o1[0] = o1[1] = e;
+        }
+    }
+
+    // ABC    E0 E1 E2
+    // DEF -> E3 E4 E5
+    // GHI    E6 E7 E8
+    static void Scale3xRow( const uint8_t* up, const uint8_t* row, const uint8_t* down, uint32_t width, uint8_t* out0, uint8_t* out1, uint8_t* out2 )
+    {
+        uint32_t x = 0;
+
+#ifdef FRM2PNG_SSE2
+        alignas( 16 ) uint8_t result[9][16];
+
+        for( ; x + 16 <= width; x += 16 )
+        {
+            const __m128i a = Load( up + x - 1 ), b = Load( up + x ), c = Load( up + x + 1 );
+            const __m128i d = Load( row + x - 1 ), e = Load( row + x ), f = Load( row + x + 1 );
+            const __m128i g = Load( down + x - 1 ), h = Load( down + x ), i = Load( down + x + 1 );
+
+            const __m128i edge = _mm_and_si128( NotEqual( b, h ), NotEqual( d, f ) );
+            const __m128i db   = _mm_and_si128( edge, _mm_cmpeq_epi8( d, b ) );
+            const __m128i bf   = _mm_and_si128( edge, _mm_cmpeq_epi8( b, f ) );
+            const __m128i dh   = _mm_and_si128( edge, _mm_cmpeq_epi8( d, h ) );
+            const __m128i hf   = _mm_and_si128( edge, _mm_cmpeq_epi8( h, f ) );
+            const __m128i ea   = NotEqual( e, a );
+            const __m128i ec   = NotEqual( e, c );
+            const __m128i eg   = NotEqual( e, g );
+            const __m128i ei   = NotEqual( e, i );
+
+            Store( result[0], Select( db, d, e ) );
+            Store( result[1], Select( _mm_or_si128( _mm_and_si128( db, ec ), _mm_and_si128( bf, ea ) ), b, e ) );
+            Store( result[2], Select( bf, f, e ) );
+            Store( result[3], Select( _mm_or_si128( _mm_and_si128( db, eg ), _mm_and_si128( dh, ea ) ), d, e ) );
+            Store( result[4], e );
+            Store( result[5], Select( _mm_or_si128( _mm_and_si128( bf, ei ), _mm_and_si128( hf, ec ) ), f, e ) );
+            Store( result[6], Select( dh, d, e ) );
+            Store( result[7], Select( _mm_or_si128( _mm_and_si128( dh, ei ), _mm_and_si128( hf, eg ) ), h, e ) );
+            Store( result[8], Select( hf, f, e ) );
+
+            // SSE2 has no 3-way interleave
+            for( uint8_t lane = 0; lane < 16; lane++ )
+            {
+                uint8_t* o0 = out0 + ( x + lane ) * 3;
+                uint8_t* o1 = out1 + ( x + lane ) * 3;
+                uint8_t* o2 = out2 + ( x + lane ) * 3;
+
+                o0[0] = result[0][lane], o0[1] = result[1][lane], o0[2] = result[2][lane];
+                o1[0] = result[3][lane], o1[1] = result[4][lane], o1[2] = result[5][lane];
+                o2[0] = result[6][lane], o2[1] = result[7][lane], o2[2] = result[8][lane];
+            }
+        }
+#endif
+
+        for( ; x < width; x++ )
+        {
+            const uint8_t* u = up + x;
+            const uint8_t* r = row + x;
+            const uint8_t* n = down + x;
+            const uint8_t  a = u[-1], b = u[0], c = u[1];
+            const uint8_t  d = r[-1], e = r[0], f = r[1];
+            const uint8_t  g = n[-1], h = n[0], i = n[1];
+            uint8_t*       o0 = out0 + x * 3;
+            uint8_t*       o1 = out1 + x * 3;
+            uint8_t*       o2 = out2 + x * 3;
+
+            if( b != h && d != f )
+            {
+                o0[0] = d == b ? d : e;
+                o0[1] = ( d == b && e != c ) || ( b == f && e != a ) ? b : e;
+                o0[2] = b == f ? f : e;
+                o1[0] = ( d == b && e != g ) || ( d == h && e != a ) ? d : e;
+                o1[1] = e;
+                o1[2] = ( b == f && e != i ) || ( h == f && e != c ) ? f : e;
+                o2[0] = d == h ? d : e;
+                o2[1] = ( d == h && e != i ) || ( h == f && e != g ) ? h : e;
+                o2[2] = h == f ? f : e;
+            }
+            else
+            {
+                std::memset( o0, e, 3 );
+                std::memset( o1, e, 3 );
+                std::memset( o2, e, 3 );
+            }
+        }
+    }
+
+    bool PngScaleFactorSupported( uint8_t factor )
+    {
+        return factor == 2 || factor == 3;
+    }
+
+    void PngScaleIndices( const uint8_t* src, uint32_t width, uint32_t height, uint8_t factor, uint8_t* dst )
+    {
+        if( !PngScaleFactorSupported( factor ) )
+            throw std::runtime_error( "PngScaleIndices() - Unsupported factor " + std::to_string( factor ) );
+
+        if( !width || !height )
+            return;
+
+        // first/last index of each row, and first/last row, are repeated
+        const std::size_t    stride = width + 2;
+        std::vector<uint8_t> padded( stride * ( height + 2 ) );
+
+        for( uint32_t y = 0; y < height + 2; y++ )
+        {
+            const uint8_t* in  = src + static_cast<std::size_t>( y ? std::min( y - 1, height - 1 ) : 0 ) * width;
+            uint8_t*       out = &padded[y * stride];
+
+            out[0] = in[0];
+            std::memcpy( out + 1, in, width );
+            out[width + 1] = in[width - 1];
+        }
+
+        const std::size_t outWidth = static_cast<std::size_t>( width ) * factor;
+
+        for( uint32_t y = 0; y < height; y++ )
+        {
+            const uint8_t* up   = &padded[y * stride + 1];
+            const uint8_t* row  = up + stride;
+            const uint8_t* down = row + stride;
+            uint8_t*       out  = dst + y * factor * outWidth;
+
+            if( factor == 2 )
+                Scale2xRow( up, row, down, width, out, out + outWidth );
+            else
+                Scale3xRow( up, row, down, width, out, out + outWidth, out + outWidth * 2 );
+        }
+    }
+
+    static void ScaleDirection( Falltergeist::Format::Frm::Direction& dir, uint8_t factor )
+    {
+        dir.ShiftX = static_cast<int16_t>( dir.ShiftX * factor );
+        dir.ShiftY = static_cast<int16_t>( dir.ShiftY * factor );
+
+        for( auto& frame : dir.Frames() )
+        {
+            if( frame.Width * factor > UINT16_MAX || frame.Height * factor > UINT16_MAX || std::abs( frame.OffsetX * factor ) > INT16_MAX || std::abs( frame.OffsetY * factor ) > INT16_MAX )
+                throw std::runtime_error( "PngScaleFrm() - Frame " + std::to_string( frame.Index ) + " too big to scale" );
+
+            Falltergeist::Format::Frm::Frame scaled( static_cast<uint16_t>( frame.Width * factor ), static_cast<uint16_t>( frame.Height * factor ), static_cast<int16_t>( frame.OffsetX * factor ), static_cast<int16_t>( frame.OffsetY * factor ) );
+            scaled.Index = frame.Index;
+
+            PngScaleIndices( frame.ColorIndexData(), frame.Width, frame.Height, factor, scaled.ColorIndexData() );
+            frame = std::move( scaled );
+        }
+    }
+
+    void PngScaleFrm( Falltergeist::Format::Frm::File& frm, uint8_t factor, ThreadPool* pool /* = nullptr */ )
+    {
+        if( !PngScaleFactorSupported( factor ) )
+            throw std::runtime_error( "PngScaleFrm() - Unsupported factor " + std::to_string( factor ) );
+
+        std::vector<std::future<void>> tasks;
+
+        for( auto& dir : frm.Directions() )
+        {
+            if( pool )
+                tasks.push_back( pool->submit( [&dir, factor]() { ScaleDirection( dir, factor ); } ) );
+            else
+                ScaleDirection( dir, factor );
+        }
+
+        for( auto& task : tasks )
+            pool->ready( task );
+        for( auto& task : tasks )
+            task.get();
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// frm2png includes
+#include "PngImage.h"
+#include "ThreadPool.h"
+
+// falltergeist includes
+#include "Format/Frm/File.h"
+
+namespace frm2png
+{
+    // area (box) filter; shrinks image passed row by row, averaging all source pixels covered by each output pixel
+    // colors are weighted by alpha, so transparent pixels don't darken edges of opaque areas
+    class PngDownscaler
+    {
+    protected:
+        uint32_t _srcWidth;
+        uint32_t _srcHeight;
+        uint32_t _dstWidth;
+        uint32_t _dstHeight;
+        uint32_t _srcY = 0;
+        uint32_t _dstY = 0;
+
+        // for each source column: output column it starts in, and weight of that part; remaining weight goes to next output column
+        std::vector<uint32_t> _column;
+        std::vector<uint32_t> _columnWeight;
+
+        // alpha weighted RGB and alpha, 4 values per output column
+        std::vector<uint64_t> _row; // current source row, filtered horizontally
+        std::vector<uint64_t> _sum; // all source rows of current output row
+
+        std::unique_ptr<PngImage> _image;
+
+    public:
+        PngDownscaler( uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight );
+
+        // rows must be added from top to bottom; each row contains srcWidth RGBA pixels
+        void addRow( const uint8_t* rgba );
+
+        // returns scaled image; must be called after all rows are added
+        std::unique_ptr<PngImage> finish();
+
+    protected:
+        void writeRow();
+    };
+
+    // pixel art upscalers working on palette indices, so output uses only colors of original image
+    // supported factors are 2 (Scale2x) and 3 (Scale3x)
+    bool PngScaleFactorSupported( uint8_t factor );
+
+    // src contains width * height indices, dst must have space for ( width * factor ) * ( height * factor ) indices
+    void PngScaleIndices( const uint8_t* src, uint32_t width, uint32_t height, uint8_t factor, uint8_t* dst );
+
+    // replaces all frames with upscaled copies; frames offsets and directions shifts are multiplied as well
+    // directions are scaled in parallel if pool is given
+    void PngScaleFrm( Falltergeist::Format::Frm::File& frm, uint8_t factor, ThreadPool* pool = nullptr );
+}
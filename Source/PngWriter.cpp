@@ -23,58 +23,66 @@
 
 // C++ standard includes
 #include <cstdint>
-#include <fstream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
 // frm2png includes
 #include "PngImage.h"
 #include "PngWriter.h"
+#include "Sink.h"
 
 // Third party includes
 #include <png.h>
 
 namespace frm2png
 {
-    PngWriter::PngWriter( const std::string& filename )
+    PngWriter::PngWriter( const std::string& filename, SinkFactory* sinks /* = nullptr */ ) :
+        _ownSink( CreateFileSink( sinks, filename ) ),
+        _sink( _ownSink.get() )
     {
-        _stream.open( filename, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary );
-        if( !_stream.is_open() )
-            throw std::runtime_error( "PngWriter::PngWriter() - Can't open output file:" + filename );
+        init();
+    }
+
+    PngWriter::PngWriter( Sink& sink ) :
+        _sink( &sink )
+    {
+        init();
+    }
 
+    void PngWriter::init()
+    {
         // Initialize write structure
         _png_write = png_create_write_struct( PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr );
         if( _png_write == nullptr )
-            throw std::runtime_error( "PngWriter::PngWriter() - Could not allocate write struct" );
+            throw std::runtime_error( "PngWriter::init() - Could not allocate write struct" );
 
         // Initialize info structure
         _png_info = png_create_info_struct( _png_write );
         if( _png_info == nullptr )
-            throw std::runtime_error( "PngWriter::PngWriter() - Could not allocate info struct" );
+            throw std::runtime_error( "PngWriter::init() - Could not allocate info struct" );
 
         // Setup Exception handling
         if( setjmp( png_jmpbuf( _png_write ) ) )
-            throw std::runtime_error( "PngWriter::PngWriter() - Error during png creation" );
+            throw std::runtime_error( "PngWriter::init() - Error during png creation" );
 
-        png_set_write_fn( _png_write, &_stream, PngWriter::writeCallback, PngWriter::flushCallback );
+        png_set_write_fn( _png_write, _sink, PngWriter::writeCallback, PngWriter::flushCallback );
     }
 
     PngWriter::~PngWriter()
     {
         png_destroy_write_struct( &_png_write, &_png_info );
-        _stream.close();
     }
 
     void PngWriter::writeCallback( png_structp png_write, png_bytep data, png_size_t length )
     {
-        std::ofstream* stream = (std::ofstream*)png_get_io_ptr( png_write );
-        stream->write( (char*)data, length );
+        Sink* sink = (Sink*)png_get_io_ptr( png_write );
+        sink->write( data, length );
     }
 
-    void PngWriter::flushCallback( png_structp png_ptr )
+    void PngWriter::flushCallback( png_structp /* png_ptr */ )
     {
-        std::ofstream* stream = (std::ofstream*)png_get_io_ptr( png_ptr ); //Get pointer to ostream
-        stream->flush();
+        // sinks decide on their own when data leaves memory
     }
 
     void PngWriter::write( const PngImage& image )
@@ -94,6 +102,8 @@ namespace frm2png
 
         // IEND chunk
         png_write_end( _png_write, _png_info );
+
+        _sink->close();
     }
 
     void PngWriter::writeAnimHeader( uint32_t width, uint32_t height, uint32_t frames, uint32_t loop, bool preview )
@@ -136,5 +146,7 @@ namespace frm2png
     {
         // IEND chunk
         png_write_end( _png_write, _png_info );
+
+        _sink->close();
     }
 }
@@ -24,27 +24,37 @@
 
 // C++ standard includes
 #include <cstdint>
-#include <fstream>
+#include <memory>
 #include <string>
 
 // frm2png includes
+#include "AnimWriter.h"
 #include "PngImage.h"
+#include "Sink.h"
 
 // Third party includes
 #include <png.h>
 
 namespace frm2png
 {
-    class PngWriter
+    class PngWriter : public AnimWriter
     {
     protected:
-        std::ofstream _stream;
-        png_structp   _png_write;
-        png_infop     _png_info;
+        std::unique_ptr<Sink> _ownSink;
+        Sink*                 _sink;
+        png_structp           _png_write;
+        png_infop             _png_info;
 
     public:
-        PngWriter( const std::string& filename );
-        ~PngWriter();
+        // encoded file is written to disk with a single write, after image/animation is complete
+        // if factory is set, it creates sink for file instead
+        PngWriter( const std::string& filename, SinkFactory* sinks = nullptr );
+        // encoded file is passed to given sink; caller keeps ownership
+        PngWriter( Sink& sink );
+        virtual ~PngWriter();
+
+    protected:
+        void init();
 
     protected:
         static void writeCallback( png_structp png_struct, png_bytep data, png_size_t length );
@@ -53,8 +63,8 @@ namespace frm2png
     public:
         void write( const PngImage& image );
 
-        void writeAnimHeader( uint32_t width, uint32_t height, uint32_t frames, uint32_t loop, bool preview );
-        void writeAnimFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint16_t delayNum, uint16_t delayDen, uint8_t dispose, uint8_t blend );
-        void writeAnimEnd();
+        virtual void writeAnimHeader( uint32_t width, uint32_t height, uint32_t frames, uint32_t loop, bool preview ) override;
+        virtual void writeAnimFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint16_t delayNum, uint16_t delayDen, uint8_t dispose, uint8_t blend ) override;
+        virtual void writeAnimEnd() override;
     };
 }
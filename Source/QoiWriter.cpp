@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "PngImage.h"
+#include "QoiWriter.h"
+#include "Sink.h"
+
+// Third party includes
+#include <png.h>
+
+namespace frm2png
+{
+    static constexpr uint8_t QOI_OP_INDEX = 0x00;
+    static constexpr uint8_t QOI_OP_DIFF  = 0x40;
+    static constexpr uint8_t QOI_OP_LUMA  = 0x80;
+    static constexpr uint8_t QOI_OP_RUN   = 0xc0;
+    static constexpr uint8_t QOI_OP_RGB   = 0xfe;
+    static constexpr uint8_t QOI_OP_RGBA  = 0xff;
+
+    static inline void Put32( std::vector<uint8_t>& buffer, uint32_t value )
+    {
+        buffer.push_back( static_cast<uint8_t>( value >> 24 ) );
+        buffer.push_back( static_cast<uint8_t>( value >> 16 ) );
+        buffer.push_back( static_cast<uint8_t>( value >> 8 ) );
+        buffer.push_back( static_cast<uint8_t>( value ) );
+    }
+
+    std::vector<uint8_t> QoiEncode( const PngImage& image )
+    {
+        const std::size_t pixels = static_cast<std::size_t>( image.width() ) * image.height();
+
+        std::vector<uint8_t> result;
+
+        // worst case: every pixel stored as QOI_OP_RGBA
+        result.reserve( 14 + pixels * 5 + 8 );
+
+        // header
+        result.insert( result.end(), { 'q', 'o', 'i', 'f' } );
+        Put32( result, image.width() );
+        Put32( result, image.height() );
+        result.push_back( 4 ); // channels
+        result.push_back( 0 ); // colorspace, sRGB with linear alpha
+
+        uint8_t  index[64][4] = {};
+        uint8_t  prev[4]      = { 0, 0, 0, 255 };
+        uint32_t run          = 0;
+
+        for( uint32_t y = 0; y < image.height(); y++ )
+        {
+            const uint8_t* px = image.rows()[y];
+
+            for( uint32_t x = 0; x < image.width(); x++, px += 4 )
+            {
+                if( std::memcmp( px, prev, 4 ) == 0 )
+                {
+                    if( ++run == 62 )
+                    {
+                        result.push_back( QOI_OP_RUN | ( run - 1 ) );
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if( run )
+                {
+                    result.push_back( QOI_OP_RUN | ( run - 1 ) );
+                    run = 0;
+                }
+
+                const uint8_t hash = ( px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11 ) % 64;
+
+                if( std::memcmp( index[hash], px, 4 ) == 0 )
+                    result.push_back( QOI_OP_INDEX | hash );
+                else
+                {
+                    std::memcpy( index[hash], px, 4 );
+
+                    if( px[3] == prev[3] )
+                    {
+                        const int8_t vr   = static_cast<int8_t>( px[0] - prev[0] );
+                        const int8_t vg   = static_cast<int8_t>( px[1] - prev[1] );
+                        const int8_t vb   = static_cast<int8_t>( px[2] - prev[2] );
+                        const int    vg_r = vr - vg;
+                        const int    vg_b = vb - vg;
+
+                        if( vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2 )
+                            result.push_back( QOI_OP_DIFF | ( vr + 2 ) << 4 | ( vg + 2 ) << 2 | ( vb + 2 ) );
+                        else if( vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8 )
+                        {
+                            result.push_back( QOI_OP_LUMA | ( vg + 32 ) );
+                            result.push_back( ( vg_r + 8 ) << 4 | ( vg_b + 8 ) );
+                        }
+                        else
+                            result.insert( result.end(), { QOI_OP_RGB, px[0], px[1], px[2] } );
+                    }
+                    else
+                        result.insert( result.end(), { QOI_OP_RGBA, px[0], px[1], px[2], px[3] } );
+                }
+
+                std::memcpy( prev, px, 4 );
+            }
+        }
+
+        if( run )
+            result.push_back( QOI_OP_RUN | ( run - 1 ) );
+
+        // end marker
+        result.insert( result.end(), { 0, 0, 0, 0, 0, 0, 0, 1 } );
+
+        return result;
+    }
+
+    QoiWriter::QoiWriter( const std::string& filename, bool sequence /* = false */, SinkFactory* sinks /* = nullptr */ ) :
+        _ownSink( sequence ? nullptr : CreateFileSink( sinks, filename ) ),
+        _sink( _ownSink.get() ),
+        _filename( filename ),
+        _sequence( sequence ),
+        _sinks( sinks )
+    {}
+
+    QoiWriter::QoiWriter( Sink& sink ) :
+        _sink( &sink ),
+        _sequence( false )
+    {}
+
+    void QoiWriter::write( const PngImage& image )
+    {
+        if( !_sink )
+            throw std::runtime_error( "QoiWriter::write() - Cannot write single image in sequence mode" );
+
+        const std::vector<uint8_t> qoi = QoiEncode( image );
+
+        _sink->write( qoi.data(), qoi.size() );
+        _sink->close();
+    }
+
+    void QoiWriter::writeAnimHeader( uint32_t width, uint32_t height, uint32_t /* frames */, uint32_t /* loop */, bool preview )
+    {
+        _canvas.reset( new PngImage( width, height ) );
+        _preview = preview;
+    }
+
+    void QoiWriter::writeAnimFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint16_t delayNum, uint16_t /* delayDen */, uint8_t dispose, uint8_t blend )
+    {
+        if( !_canvas )
+            throw std::runtime_error( "QoiWriter::writeAnimFrame() - Header not written" );
+        if( offsetX + image.width() > _canvas->width() || offsetY + image.height() > _canvas->height() )
+            throw std::runtime_error( "QoiWriter::writeAnimFrame() - Frame outside of image" );
+
+        // hidden preview image is always first frame
+        if( _preview )
+        {
+            _preview = false;
+            return;
+        }
+
+        disposeFrame();
+
+        // area is saved before drawing, so it can be restored after frame is displayed
+        if( dispose == PNG_DISPOSE_OP_PREVIOUS )
+            _previous.reset( new PngImage( *_canvas, offsetX, offsetY, image.width(), image.height() ) );
+
+        drawFrame( image, offsetX, offsetY, blend );
+
+        for( uint16_t repeat = 0; repeat < ( delayNum ? delayNum : 1 ); repeat++ )
+            writeCanvas();
+
+        _disposeX      = offsetX;
+        _disposeY      = offsetY;
+        _disposeWidth  = image.width();
+        _disposeHeight = image.height();
+        _dispose       = dispose;
+    }
+
+    void QoiWriter::writeAnimEnd()
+    {
+        if( _sequence )
+            return;
+
+        if( _frames.empty() )
+            throw std::runtime_error( "QoiWriter::writeAnimEnd() - No frames" );
+
+        const uint32_t frameWidth = _frames.front()->width();
+        PngImage       sheet( frameWidth * static_cast<uint32_t>( _frames.size() ), _frames.front()->height() );
+
+        for( std::size_t idx = 0; idx < _frames.size(); idx++ )
+        {
+            for( uint32_t y = 0; y < sheet.height(); y++ )
+            {
+                std::memcpy( sheet.rows()[y] + idx * frameWidth * 4, _frames[idx]->rows()[y], frameWidth * 4 );
+            }
+        }
+
+        _frames.clear();
+        write( sheet );
+    }
+
+    void QoiWriter::disposeFrame()
+    {
+        if( _dispose == PNG_DISPOSE_OP_BACKGROUND )
+        {
+            for( uint32_t y = _disposeY; y < _disposeY + _disposeHeight; y++ )
+                std::memset( _canvas->rows()[y] + _disposeX * 4, 0, _disposeWidth * 4 );
+        }
+        else if( _dispose == PNG_DISPOSE_OP_PREVIOUS && _previous )
+        {
+            for( uint32_t y = 0; y < _disposeHeight; y++ )
+                std::memcpy( _canvas->rows()[_disposeY + y] + _disposeX * 4, _previous->rows()[y], _disposeWidth * 4 );
+
+            _previous.reset();
+        }
+
+        _dispose = PNG_DISPOSE_OP_NONE;
+    }
+
+    void QoiWriter::drawFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint8_t blend )
+    {
+        for( uint32_t y = 0; y < image.height(); y++ )
+        {
+            const uint8_t* src = image.rows()[y];
+            uint8_t*       dst = _canvas->rows()[offsetY + y] + offsetX * 4;
+
+            if( blend == PNG_BLEND_OP_SOURCE )
+            {
+                std::memcpy( dst, src, image.width() * 4 );
+                continue;
+            }
+
+            for( uint32_t x = 0; x < image.width(); x++, src += 4, dst += 4 )
+            {
+                if( src[3] == 255 || !dst[3] )
+                    std::memcpy( dst, src, 4 );
+                else if( src[3] )
+                {
+                    // APNG 'over' operation, non-premultiplied alpha
+                    const uint32_t srcA = src[3];
+                    const uint32_t dstA = dst[3] * ( 255 - srcA ) / 255;
+                    const uint32_t outA = srcA + dstA;
+
+                    for( uint8_t c = 0; c < 3; c++ )
+                        dst[c] = static_cast<uint8_t>( ( src[c] * srcA + dst[c] * dstA ) / outA );
+                    dst[3] = static_cast<uint8_t>( outA );
+                }
+            }
+        }
+    }
+
+    void QoiWriter::writeCanvas()
+    {
+        if( !_sequence )
+        {
+            _frames.emplace_back( new PngImage( *_canvas, 0, 0, _canvas->width(), _canvas->height() ) );
+            return;
+        }
+
+        // name.ext -> name_F.ext
+        std::string                  filename = _filename;
+        const std::string::size_type dot      = filename.find_last_of( '.' );
+        const std::string::size_type slash    = filename.find_last_of( '/' );
+        const std::string            suffix   = "_" + std::to_string( _sequenceIdx++ );
+
+        if( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) )
+            filename.insert( dot, suffix );
+        else
+            filename += suffix;
+
+        const std::vector<uint8_t> qoi = QoiEncode( *_canvas );
+
+        std::unique_ptr<Sink> sink = CreateFileSink( _sinks, filename, qoi.size() );
+        sink->write( qoi.data(), qoi.size() );
+        sink->close();
+
+        _sequenceFiles.push_back( filename );
+    }
+
+    std::vector<std::string> QoiWriter::files() const
+    {
+        if( _sequence )
+            return _sequenceFiles;
+        else if( _ownSink )
+            return { _filename };
+
+        return {};
+    }
+}
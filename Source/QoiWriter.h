@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "AnimWriter.h"
+#include "PngImage.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+    // encodes RGBA image as QOI (https://qoiformat.org/)
+    std::vector<uint8_t> QoiEncode( const PngImage& image );
+
+    // QOI has no animation support; frames are composed the same way as APNG frames, then either
+    // - placed next to each other, in single row (sheet)
+    // - written as separate files, 'name_F.qoi' (sequence)
+    // frame displayed for N delay units is stored N times; hidden preview image is skipped
+    class QoiWriter : public AnimWriter
+    {
+    protected:
+        std::unique_ptr<Sink> _ownSink;
+        Sink*                 _sink;
+        std::string           _filename;
+        bool                  _sequence;
+        SinkFactory*          _sinks = nullptr;
+
+        std::unique_ptr<PngImage>              _canvas;
+        std::unique_ptr<PngImage>              _previous;
+        std::vector<std::unique_ptr<PngImage>> _frames;
+
+        uint32_t                 _sequenceIdx = 0;
+        std::vector<std::string> _sequenceFiles;
+        bool                     _preview = false;
+
+        // area and dispose operation of last frame
+        uint32_t _disposeX = 0, _disposeY = 0, _disposeWidth = 0, _disposeHeight = 0;
+        uint8_t  _dispose  = 0;
+
+    public:
+        // sequence mode requires filename, each frame is written to own file
+        // if factory is set, it creates sinks for files instead of writing to disk
+        QoiWriter( const std::string& filename, bool sequence = false, SinkFactory* sinks = nullptr );
+        // encoded file is passed to given sink; caller keeps ownership
+        QoiWriter( Sink& sink );
+
+        void write( const PngImage& image );
+
+        // names of created files; empty if output was passed to caller's sink
+        std::vector<std::string> files() const;
+
+        virtual void writeAnimHeader( uint32_t width, uint32_t height, uint32_t frames, uint32_t loop, bool preview ) override;
+        virtual void writeAnimFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint16_t delayNum, uint16_t delayDen, uint8_t dispose, uint8_t blend ) override;
+        virtual void writeAnimEnd() override;
+
+    protected:
+        void disposeFrame();
+        void drawFrame( const PngImage& image, uint32_t offsetX, uint32_t offsetY, uint8_t blend );
+        void writeCanvas();
+    };
+}
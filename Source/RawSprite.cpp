@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "RawSprite.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+    static inline void Put16( std::vector<uint8_t>& buffer, uint16_t value )
+    {
+        buffer.push_back( static_cast<uint8_t>( value ) );
+        buffer.push_back( static_cast<uint8_t>( value >> 8 ) );
+    }
+
+    static inline void Put32( std::vector<uint8_t>& buffer, uint32_t value )
+    {
+        Put16( buffer, static_cast<uint16_t>( value ) );
+        Put16( buffer, static_cast<uint16_t>( value >> 16 ) );
+    }
+
+    static inline std::size_t Align( std::size_t offset )
+    {
+        return ( offset + RawSpriteAlignment - 1 ) / RawSpriteAlignment * RawSpriteAlignment;
+    }
+
+    static inline void Pad( std::vector<uint8_t>& buffer )
+    {
+        buffer.resize( Align( buffer.size() ), 0 );
+    }
+
+    void RawSpriteWrite( Sink& sink, const RawSpriteData& data )
+    {
+        const std::size_t bpp = data.PixelFormat == RawSpritePixelFormat::Indexed ? 1 : 4;
+
+        if( data.Frames.size() != data.Pixels.size() )
+            throw std::runtime_error( "RawSpriteWrite() - Frames/pixels mismatch" );
+        if( data.PixelFormat == RawSpritePixelFormat::Indexed && data.Palette.size() != 256 * 4 )
+            throw std::runtime_error( "RawSpriteWrite() - Invalid palette" );
+
+        // calculate layout
+
+        const std::size_t directionTableOffset = Align( sizeof( RawSpriteHeader ) );
+        const std::size_t frameTableOffset     = Align( directionTableOffset + data.Directions.size() * sizeof( RawSpriteDirection ) );
+        const std::size_t paletteOffset        = Align( frameTableOffset + data.Frames.size() * sizeof( RawSpriteFrame ) );
+        const std::size_t pixelsOffset         = Align( paletteOffset + ( data.PixelFormat == RawSpritePixelFormat::Indexed ? data.Palette.size() : 0 ) );
+
+        std::vector<uint32_t> framePixelsOffset;
+        std::size_t           fileSize = pixelsOffset;
+
+        for( std::size_t idx = 0; idx < data.Frames.size(); idx++ )
+        {
+            const RawSpriteFrame& frame = data.Frames[idx];
+
+            if( data.Pixels[idx].size() != frame.Width * frame.Height * bpp )
+                throw std::runtime_error( "RawSpriteWrite() - Invalid pixels size, frame " + std::to_string( idx ) );
+
+            framePixelsOffset.push_back( static_cast<uint32_t>( fileSize ) );
+            fileSize = Align( fileSize + data.Pixels[idx].size() );
+        }
+
+        if( fileSize > std::numeric_limits<uint32_t>::max() )
+            throw std::runtime_error( "RawSpriteWrite() - File too big" );
+
+        // all tables are small enough to be kept in single buffer; pixels are written directly
+
+        std::vector<uint8_t> buffer;
+        buffer.reserve( pixelsOffset );
+
+        buffer.insert( buffer.end(), RawSpriteMagic, RawSpriteMagic + sizeof( RawSpriteMagic ) );
+        Put32( buffer, RawSpriteVersion );
+        Put32( buffer, sizeof( RawSpriteHeader ) );
+        Put32( buffer, static_cast<uint32_t>( data.PixelFormat ) );
+        Put32( buffer, static_cast<uint32_t>( data.Directions.size() ) );
+        Put32( buffer, data.FramesPerDirection );
+        Put32( buffer, data.FramesPerSecond );
+        Put32( buffer, data.ActionFrame );
+        Put32( buffer, static_cast<uint32_t>( directionTableOffset ) );
+        Put32( buffer, static_cast<uint32_t>( frameTableOffset ) );
+        Put32( buffer, data.PixelFormat == RawSpritePixelFormat::Indexed ? static_cast<uint32_t>( paletteOffset ) : 0 );
+        Put32( buffer, static_cast<uint32_t>( pixelsOffset ) );
+        Put32( buffer, static_cast<uint32_t>( fileSize ) );
+        Put32( buffer, RawSpriteAlignment );
+        Put32( buffer, 0 );
+        Put32( buffer, 0 );
+        Pad( buffer );
+
+        for( const auto& direction : data.Directions )
+        {
+            Put32( buffer, direction.Width );
+            Put32( buffer, direction.Height );
+            Put32( buffer, direction.FirstFrame );
+            Put32( buffer, direction.Frames );
+        }
+        Pad( buffer );
+
+        for( std::size_t idx = 0; idx < data.Frames.size(); idx++ )
+        {
+            const RawSpriteFrame& frame = data.Frames[idx];
+
+            Put16( buffer, frame.Width );
+            Put16( buffer, frame.Height );
+            Put16( buffer, static_cast<uint16_t>( frame.FrmOffsetX ) );
+            Put16( buffer, static_cast<uint16_t>( frame.FrmOffsetY ) );
+            Put32( buffer, frame.X );
+            Put32( buffer, frame.Y );
+            Put32( buffer, frame.HotspotX );
+            Put32( buffer, frame.HotspotY );
+            Put32( buffer, framePixelsOffset[idx] );
+            Put32( buffer, static_cast<uint32_t>( data.Pixels[idx].size() ) );
+        }
+        Pad( buffer );
+
+        if( data.PixelFormat == RawSpritePixelFormat::Indexed )
+        {
+            buffer.insert( buffer.end(), data.Palette.begin(), data.Palette.end() );
+            Pad( buffer );
+        }
+
+        sink.write( buffer.data(), buffer.size() );
+
+        static const uint8_t padding[RawSpriteAlignment] = {};
+        for( const auto& pixels : data.Pixels )
+        {
+            sink.write( pixels.data(), pixels.size() );
+            sink.write( padding, Align( pixels.size() ) - pixels.size() );
+        }
+
+        sink.close();
+    }
+}
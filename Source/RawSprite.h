@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <vector>
+
+// frm2png includes
+#include "Sink.h"
+
+namespace frm2png
+{
+    // flat sprite container which can be memory-mapped and used without parsing
+    //
+    // layout:
+    //   RawSpriteHeader
+    //   RawSpriteDirection[Directions]
+    //   RawSpriteFrame[Directions * FramesPerDirection], ordered by direction
+    //   palette (Indexed only), 256 RGBA colors
+    //   pixels of each frame, rows without padding, each block aligned to RawSpriteAlignment
+    //
+    // all values are little-endian; all offsets are relative to start of file
+
+    static constexpr char     RawSpriteMagic[4]  = { 'F', 'R', 'M', 'R' };
+    static constexpr uint32_t RawSpriteVersion   = 1;
+    static constexpr uint32_t RawSpriteAlignment = 16;
+
+    enum class RawSpritePixelFormat : uint32_t
+    {
+        Indexed = 0, // 1 byte per pixel, palette index
+        Rgba    = 1  // 4 bytes per pixel
+    };
+
+    struct RawSpriteHeader
+    {
+        char     Magic[4];
+        uint32_t Version;
+        uint32_t HeaderSize;
+        uint32_t PixelFormat;
+        uint32_t Directions;
+        uint32_t FramesPerDirection;
+        uint32_t FramesPerSecond;
+        uint32_t ActionFrame;
+        uint32_t DirectionTableOffset;
+        uint32_t FrameTableOffset;
+        uint32_t PaletteOffset; // 0 if there is no palette
+        uint32_t PixelsOffset;
+        uint32_t FileSize;
+        uint32_t Alignment;
+        uint32_t Reserved[2];
+    };
+
+    struct RawSpriteDirection
+    {
+        // minimum size required to draw all frames of direction
+        uint32_t Width;
+        uint32_t Height;
+
+        uint32_t FirstFrame;
+        uint32_t Frames;
+    };
+
+    struct RawSpriteFrame
+    {
+        uint16_t Width;
+        uint16_t Height;
+
+        // original .frm offsets
+        int16_t FrmOffsetX;
+        int16_t FrmOffsetY;
+
+        // position of frame inside direction area
+        uint32_t X;
+        uint32_t Y;
+
+        // position of .frm hotspot inside direction area
+        uint32_t HotspotX;
+        uint32_t HotspotY;
+
+        uint32_t PixelsOffset;
+        uint32_t PixelsSize;
+    };
+
+    static_assert( sizeof( RawSpriteHeader ) == 64, "RawSpriteHeader - invalid size" );
+    static_assert( sizeof( RawSpriteDirection ) == 16, "RawSpriteDirection - invalid size" );
+    static_assert( sizeof( RawSpriteFrame ) == 32, "RawSpriteFrame - invalid size" );
+
+    // everything needed to write container; offsets are filled by RawSpriteWrite()
+    struct RawSpriteData
+    {
+        RawSpritePixelFormat PixelFormat = RawSpritePixelFormat::Indexed;
+
+        uint32_t FramesPerDirection = 0;
+        uint32_t FramesPerSecond    = 0;
+        uint32_t ActionFrame        = 0;
+
+        std::vector<RawSpriteDirection> Directions;
+        std::vector<RawSpriteFrame>     Frames;
+
+        // Pixels[F] = frame F, Width * Height * bytes per pixel
+        std::vector<std::vector<uint8_t>> Pixels;
+
+        // 256 RGBA colors, required by Indexed only
+        std::vector<uint8_t> Palette;
+    };
+
+    // writes container to sink, and closes it
+    void RawSpriteWrite( Sink& sink, const RawSpriteData& data );
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// frm2png includes
+#include "RectPacker.h"
+
+namespace frm2png
+{
+    MaxRectsPacker::MaxRectsPacker( uint32_t width, uint32_t height ) :
+        _width( width ),
+        _height( height )
+    {
+        if( !width || !height )
+            throw std::runtime_error( "MaxRectsPacker::MaxRectsPacker() - Invalid size" );
+
+        _free.push_back( { 0, 0, width, height } );
+    }
+
+    uint32_t MaxRectsPacker::width() const
+    {
+        return _width;
+    }
+
+    uint32_t MaxRectsPacker::height() const
+    {
+        return _height;
+    }
+
+    uint32_t MaxRectsPacker::usedWidth() const
+    {
+        return _usedWidth;
+    }
+
+    uint32_t MaxRectsPacker::usedHeight() const
+    {
+        return _usedHeight;
+    }
+
+    bool MaxRectsPacker::insert( uint32_t width, uint32_t height, uint32_t& x, uint32_t& y )
+    {
+        x = y = 0;
+
+        if( !width || !height )
+            return true;
+
+        // best short side fit; ties resolved using long side
+        const Rect* best          = nullptr;
+        uint32_t    bestShortSide = std::numeric_limits<uint32_t>::max();
+        uint32_t    bestLongSide  = std::numeric_limits<uint32_t>::max();
+
+        for( const auto& free : _free )
+        {
+            if( free.Width < width || free.Height < height )
+                continue;
+
+            const uint32_t leftoverX = free.Width - width;
+            const uint32_t leftoverY = free.Height - height;
+            const uint32_t shortSide = std::min( leftoverX, leftoverY );
+            const uint32_t longSide  = std::max( leftoverX, leftoverY );
+
+            if( shortSide < bestShortSide || ( shortSide == bestShortSide && longSide < bestLongSide ) )
+            {
+                best          = &free;
+                bestShortSide = shortSide;
+                bestLongSide  = longSide;
+            }
+        }
+
+        if( !best )
+            return false;
+
+        const Rect used = { best->X, best->Y, width, height };
+
+        splitFree( used );
+        pruneFree();
+
+        x           = used.X;
+        y           = used.Y;
+        _usedWidth  = std::max( _usedWidth, used.X + used.Width );
+        _usedHeight = std::max( _usedHeight, used.Y + used.Height );
+
+        return true;
+    }
+
+    // replaces free rects overlapping used area with up to four rects around it
+    void MaxRectsPacker::splitFree( const Rect& used )
+    {
+        std::vector<Rect> result;
+        result.reserve( _free.size() + 4 );
+
+        for( const auto& free : _free )
+        {
+            if( used.X >= free.X + free.Width || used.X + used.Width <= free.X || used.Y >= free.Y + free.Height || used.Y + used.Height <= free.Y )
+            {
+                result.push_back( free );
+                continue;
+            }
+
+            if( used.X > free.X )
+                result.push_back( { free.X, free.Y, used.X - free.X, free.Height } );
+            if( used.X + used.Width < free.X + free.Width )
+                result.push_back( { used.X + used.Width, free.Y, free.X + free.Width - used.X - used.Width, free.Height } );
+            if( used.Y > free.Y )
+                result.push_back( { free.X, free.Y, free.Width, used.Y - free.Y } );
+            if( used.Y + used.Height < free.Y + free.Height )
+                result.push_back( { free.X, used.Y + used.Height, free.Width, free.Y + free.Height - used.Y - used.Height } );
+        }
+
+        _free.swap( result );
+    }
+
+    // removes free rects fully contained in other free rects
+    void MaxRectsPacker::pruneFree()
+    {
+        auto contains = []( const Rect& outer, const Rect& inner ) {
+            return inner.X >= outer.X && inner.Y >= outer.Y && inner.X + inner.Width <= outer.X + outer.Width && inner.Y + inner.Height <= outer.Y + outer.Height;
+        };
+
+        std::vector<bool> removed( _free.size(), false );
+
+        for( std::size_t i = 0; i < _free.size(); i++ )
+        {
+            if( removed[i] )
+                continue;
+
+            for( std::size_t j = 0; j < _free.size(); j++ )
+            {
+                if( i == j || removed[j] )
+                    continue;
+
+                if( contains( _free[i], _free[j] ) )
+                    removed[j] = true;
+                else if( contains( _free[j], _free[i] ) )
+                {
+                    removed[i] = true;
+                    break;
+                }
+            }
+        }
+
+        std::vector<Rect> result;
+        result.reserve( _free.size() );
+
+        for( std::size_t idx = 0; idx < _free.size(); idx++ )
+        {
+            if( !removed[idx] )
+                result.push_back( _free[idx] );
+        }
+
+        _free.swap( result );
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <vector>
+
+namespace frm2png
+{
+    // MaxRects bin packer, using best short side fit heuristic
+    // rects are placed one by one, in order of insert() calls; callers should insert bigger rects first
+    class MaxRectsPacker
+    {
+    protected:
+        struct Rect
+        {
+            uint32_t X, Y, Width, Height;
+        };
+
+        uint32_t          _width;
+        uint32_t          _height;
+        uint32_t          _usedWidth  = 0;
+        uint32_t          _usedHeight = 0;
+        std::vector<Rect> _free;
+
+    public:
+        MaxRectsPacker( uint32_t width, uint32_t height );
+
+        uint32_t width() const;
+        uint32_t height() const;
+
+        // smallest area, starting at 0,0, which contains all inserted rects
+        uint32_t usedWidth() const;
+        uint32_t usedHeight() const;
+
+        // finds position for rect of given size; returns false if there is no space left
+        // empty rects are always placed at 0,0
+        bool insert( uint32_t width, uint32_t height, uint32_t& x, uint32_t& y );
+
+    protected:
+        void splitFree( const Rect& used );
+        void pruneFree();
+    };
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// system includes
+#if !defined( _WIN32 )
+    #include <cerrno>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+// frm2png includes
+#include "Job.h"
+#include "LruCache.h"
+#include "PngGenerator.h"
+#include "Server.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+#if defined( _WIN32 )
+
+    void RunServer( const std::string&, ThreadPool&, Logging& )
+    {
+        throw std::runtime_error( "RunServer() - Server mode is not supported on this platform" );
+    }
+
+#else
+
+    struct ServerState
+    {
+        ThreadPool& Pool;
+        Logging&    LogVerbose;
+        std::mutex  LogLock;
+
+        // .frm files, palettes and archives used by previous requests
+        JobSources Sources;
+
+        // complete responses of requests returning files; key includes stamps of all sources, so changed files are converted again
+        LruCache<std::string> Responses;
+
+        std::atomic<bool>       Stop;
+        std::mutex              ConnectionsLock;
+        std::condition_variable ConnectionsDone;
+        std::size_t             Connections = 0;
+
+        ServerState( ThreadPool& pool, Logging& logVerbose ) :
+            Pool( pool ),
+            LogVerbose( logVerbose ),
+            Sources( 256 * 1024 * 1024 ),
+            Responses( 256 * 1024 * 1024 ),
+            Stop( false )
+        {}
+    };
+
+    static std::string Convert( ServerState& state, const Job& job, Logging& logVerbose )
+    {
+        // files written to disk are converted every time, as they could have been removed or modified since previous request
+
+        const bool  memory = job.get( "output" ).empty();
+        std::string responseKey;
+
+        if( memory )
+        {
+            std::string frmKey, palKey;
+            state.Sources.frm( job, frmKey );
+            state.Sources.palette( job, palKey );
+
+            for( const auto& field : job.Fields )
+                responseKey += field.first + "=" + field.second + "\n";
+
+            responseKey += frmKey + "\n" + palKey;
+
+            std::shared_ptr<const std::string> response = state.Responses.find( responseKey );
+            if( response )
+            {
+                logVerbose << "cached response = " + job.get( "input" );
+                return *response;
+            }
+        }
+
+        MemorySinkFactory sinks;
+        PngOutputList     outputs;
+
+        RunJob( job, state.Sources, state.Pool, memory ? &sinks : nullptr, &outputs, logVerbose );
+
+        std::string response;
+
+        if( memory )
+        {
+            // generators finish files in random order when running in parallel
+            std::vector<std::pair<std::string, std::vector<uint8_t>>> files = sinks.release();
+            std::sort( files.begin(), files.end(), []( const std::pair<std::string, std::vector<uint8_t>>& a, const std::pair<std::string, std::vector<uint8_t>>& b ) { return a.first < b.first; } );
+
+            response = "ok\t" + std::to_string( files.size() ) + "\n";
+            for( const auto& file : files )
+            {
+                response += file.first + "\t" + std::to_string( file.second.size() ) + "\n";
+                response.append( reinterpret_cast<const char*>( file.second.data() ), file.second.size() );
+            }
+
+            state.Responses.add( responseKey, std::make_shared<const std::string>( response ), response.size() );
+        }
+        else
+        {
+            response = "ok\t" + std::to_string( outputs.files().size() ) + "\n";
+            for( const std::string& file : outputs.files() )
+                response += file + "\t-\n";
+        }
+
+        return response;
+    }
+
+    // returns false when connection is closed, or when server is stopping and client is idle
+    static bool ReadLine( ServerState& state, int client, std::string& buffer, std::string& line )
+    {
+        static const std::size_t limit = 64 * 1024;
+
+        while( true )
+        {
+            const size_t pos = buffer.find( '\n' );
+            if( pos != std::string::npos )
+            {
+                line = buffer.substr( 0, pos );
+                buffer.erase( 0, pos + 1 );
+
+                if( !line.empty() && line.back() == '\r' )
+                    line.pop_back();
+
+                return true;
+            }
+
+            if( buffer.size() > limit )
+                return false;
+
+            pollfd poller = { client, POLLIN, 0 };
+            int    ready  = poll( &poller, 1, 200 );
+
+            if( ready < 0 && errno != EINTR )
+                return false;
+            else if( ready <= 0 )
+            {
+                if( state.Stop && buffer.empty() )
+                    return false;
+
+                continue;
+            }
+
+            char    chunk[4096];
+            ssize_t length = recv( client, chunk, sizeof( chunk ), 0 );
+
+            if( length < 0 && errno == EINTR )
+                continue;
+            else if( length <= 0 )
+                return false;
+
+            buffer.append( chunk, static_cast<std::size_t>( length ) );
+        }
+    }
+
+    static bool SendAll( int client, const std::string& data )
+    {
+    #if defined( MSG_NOSIGNAL )
+        const int flags = MSG_NOSIGNAL;
+    #else
+        const int flags = 0; // see SO_NOSIGPIPE in RunServer()
+    #endif
+
+        std::size_t sent = 0;
+        while( sent < data.size() )
+        {
+            ssize_t length = send( client, data.data() + sent, data.size() - sent, flags );
+
+            if( length < 0 && errno == EINTR )
+                continue;
+            else if( length <= 0 )
+                return false;
+
+            sent += static_cast<std::size_t>( length );
+        }
+
+        return true;
+    }
+
+    static void ServeClient( ServerState& state, int client )
+    {
+        std::string buffer, line;
+
+        while( ReadLine( state, client, buffer, line ) )
+        {
+            Logging     logVerbose( state.LogVerbose.Enabled, true, state.LogVerbose.Indent );
+            std::string response;
+
+            logVerbose << "request = " + line << 1;
+
+            try
+            {
+                const size_t      pos     = line.find( '\t' );
+                const std::string command = line.substr( 0, pos );
+
+                if( command == "ping" )
+                    response = "ok\t0\n";
+                else if( command == "shutdown" )
+                {
+                    state.Stop = true;
+                    response   = "ok\t0\n";
+                }
+                else if( command == "convert" )
+                    response = Convert( state, Job( pos != std::string::npos ? line.substr( pos + 1 ) : "" ), logVerbose );
+                else
+                    throw std::runtime_error( "RunServer() - Unknown command: '" + command + "'" );
+            }
+            catch( std::exception& e )
+            {
+                std::string message = e.what();
+                std::replace( message.begin(), message.end(), '\n', ' ' );
+                std::replace( message.begin(), message.end(), '\t', ' ' );
+
+                logVerbose << "error = " + message;
+                response = "error\t" + message + "\n";
+            }
+
+            logVerbose << -1;
+
+            {
+                std::lock_guard<std::mutex> lock( state.LogLock );
+                state.LogVerbose.Replay( logVerbose );
+            }
+
+            if( !SendAll( client, response ) )
+                break;
+        }
+
+        close( client );
+
+        std::lock_guard<std::mutex> lock( state.ConnectionsLock );
+        state.Connections--;
+        state.ConnectionsDone.notify_all();
+    }
+
+    void RunServer( const std::string& socketname, ThreadPool& pool, Logging& logVerbose )
+    {
+        ServerState state( pool, logVerbose );
+        sockaddr_un address;
+
+        std::memset( &address, 0, sizeof( address ) );
+        address.sun_family = AF_UNIX;
+
+        if( socketname.empty() || socketname.size() >= sizeof( address.sun_path ) )
+            throw std::runtime_error( "RunServer() - Invalid socket name: " + socketname );
+
+        std::memcpy( address.sun_path, socketname.c_str(), socketname.size() );
+
+        // socket left by server which didn't exit cleanly
+        struct stat info;
+        if( lstat( socketname.c_str(), &info ) == 0 && S_ISSOCK( info.st_mode ) )
+            unlink( socketname.c_str() );
+
+        int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+        if( listener < 0 )
+            throw std::runtime_error( "RunServer() - Can't create socket: " + std::string( std::strerror( errno ) ) );
+
+        if( bind( listener, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) != 0 || listen( listener, SOMAXCONN ) != 0 )
+        {
+            const std::string error = std::strerror( errno );
+            close( listener );
+
+            throw std::runtime_error( "RunServer() - Can't listen on socket: " + socketname + " (" + error + ")" );
+        }
+
+        std::cout << "Listening on " << socketname << std::endl;
+
+        // stop flag is checked every now and then, so accept() can't block forever
+        while( !state.Stop )
+        {
+            pollfd poller = { listener, POLLIN, 0 };
+            if( poll( &poller, 1, 200 ) <= 0 )
+                continue;
+
+            int client = accept( listener, nullptr, nullptr );
+            if( client < 0 )
+                continue;
+
+    #if defined( SO_NOSIGPIPE )
+            int enable = 1;
+            setsockopt( client, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof( enable ) );
+    #endif
+
+            {
+                std::lock_guard<std::mutex> lock( state.ConnectionsLock );
+                state.Connections++;
+            }
+
+            try
+            {
+                std::thread( ServeClient, std::ref( state ), client ).detach();
+            }
+            catch( std::exception& e )
+            {
+                close( client );
+
+                std::lock_guard<std::mutex> lock( state.ConnectionsLock );
+                state.Connections--;
+
+                std::lock_guard<std::mutex> logLock( state.LogLock );
+                logVerbose << "can't start connection thread = " + std::string( e.what() );
+            }
+        }
+
+        close( listener );
+        unlink( socketname.c_str() );
+
+        // clients finish current request, and are disconnected once idle
+        std::unique_lock<std::mutex> lock( state.ConnectionsLock );
+        state.ConnectionsDone.wait( lock, [&state]() { return state.Connections == 0; } );
+    }
+
+#endif
+}
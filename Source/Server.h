@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <string>
+
+// frm2png includes
+#include "Logging.h"
+#include "ThreadPool.h"
+
+namespace frm2png
+{
+    // converts files on request, received over unix domain socket; returns after 'shutdown' request, once all clients disconnected
+    // loaded files, palettes and results are kept in memory between requests, so repeated conversions skip most of the work
+    //
+    // each request is single line: command, followed by tab separated key=value fields
+    //   ping
+    //   shutdown
+    //   convert <fields>, see Job
+    //
+    // each response starts with 'ok<TAB>N' line followed by N files, or with 'error<TAB>message' line
+    // every file is described by 'name<TAB>size' line, followed by size bytes of content
+    // when output is set, files are written to disk (as with --output), and only their names are sent; size is '-', without content
+    void RunServer( const std::string& socket, ThreadPool& pool, Logging& logVerbose );
+}
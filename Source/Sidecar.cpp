@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "Json.h"
+#include "Sidecar.h"
+#include "Sink.h"
+
+namespace frm2png
+{
+    bool SidecarFormatFromString( const std::string& name, SidecarFormat& format )
+    {
+        if( name == "none" )
+            format = SidecarFormat::None;
+        else if( name == "json" )
+            format = SidecarFormat::Json;
+        else if( name == "binary" )
+            format = SidecarFormat::Binary;
+        else
+            return false;
+
+        return true;
+    }
+
+    std::string SidecarToJson( const Sidecar& sidecar )
+    {
+        JsonWriter json;
+
+        json.beginObject();
+        json.key( "image" ).value( sidecar.Image );
+        json.key( "width" ).value( sidecar.Width );
+        json.key( "height" ).value( sidecar.Height );
+        json.key( "fps" ).value( sidecar.FramesPerSecond );
+        json.key( "actionFrame" ).value( sidecar.ActionFrame );
+        json.key( "framesPerDirection" ).value( sidecar.FramesPerDirection );
+
+        json.key( "directions" ).beginArray();
+        for( const auto& direction : sidecar.Directions )
+        {
+            json.beginObject();
+            json.key( "index" ).value( direction.Index );
+            json.key( "x" ).value( direction.X );
+            json.key( "y" ).value( direction.Y );
+            json.key( "w" ).value( direction.Width );
+            json.key( "h" ).value( direction.Height );
+            json.key( "shiftX" ).value( direction.ShiftX );
+            json.key( "shiftY" ).value( direction.ShiftY );
+            json.endObject();
+        }
+        json.endArray();
+
+        json.key( "frames" ).beginArray();
+        for( const auto& frame : sidecar.Frames )
+        {
+            json.beginObject();
+            json.key( "direction" ).value( frame.Direction );
+            json.key( "frame" ).value( frame.Frame );
+            json.key( "x" ).value( frame.X );
+            json.key( "y" ).value( frame.Y );
+            json.key( "w" ).value( frame.Width );
+            json.key( "h" ).value( frame.Height );
+            json.key( "offsetX" ).value( frame.OffsetX );
+            json.key( "offsetY" ).value( frame.OffsetY );
+            json.key( "hotspotX" ).value( frame.HotspotX );
+            json.key( "hotspotY" ).value( frame.HotspotY );
+            json.endObject();
+        }
+        json.endArray();
+
+        json.endObject();
+
+        return json.str();
+    }
+
+    static inline void Put16( std::vector<uint8_t>& buffer, uint16_t value )
+    {
+        buffer.push_back( static_cast<uint8_t>( value ) );
+        buffer.push_back( static_cast<uint8_t>( value >> 8 ) );
+    }
+
+    static inline void Put32( std::vector<uint8_t>& buffer, uint32_t value )
+    {
+        Put16( buffer, static_cast<uint16_t>( value ) );
+        Put16( buffer, static_cast<uint16_t>( value >> 16 ) );
+    }
+
+    std::vector<uint8_t> SidecarToBinary( const Sidecar& sidecar )
+    {
+        if( sidecar.Image.size() > UINT16_MAX )
+            throw std::runtime_error( "SidecarToBinary() - Image name too long" );
+
+        std::vector<uint8_t> result;
+        result.reserve( 32 + sidecar.Image.size() + sidecar.Directions.size() * 28 + sidecar.Frames.size() * 36 );
+
+        for( char c : SidecarMagic )
+            result.push_back( static_cast<uint8_t>( c ) );
+
+        Put32( result, SidecarVersion );
+        Put32( result, sidecar.Width );
+        Put32( result, sidecar.Height );
+        Put16( result, sidecar.FramesPerSecond );
+        Put16( result, sidecar.ActionFrame );
+        Put16( result, sidecar.FramesPerDirection );
+        Put16( result, static_cast<uint16_t>( sidecar.Image.size() ) );
+        result.insert( result.end(), sidecar.Image.begin(), sidecar.Image.end() );
+        Put32( result, static_cast<uint32_t>( sidecar.Directions.size() ) );
+        Put32( result, static_cast<uint32_t>( sidecar.Frames.size() ) );
+
+        for( const auto& direction : sidecar.Directions )
+        {
+            Put32( result, direction.Index );
+            Put32( result, direction.X );
+            Put32( result, direction.Y );
+            Put32( result, direction.Width );
+            Put32( result, direction.Height );
+            Put32( result, static_cast<uint32_t>( direction.ShiftX ) );
+            Put32( result, static_cast<uint32_t>( direction.ShiftY ) );
+        }
+
+        for( const auto& frame : sidecar.Frames )
+        {
+            Put32( result, frame.Direction );
+            Put32( result, frame.Frame );
+            Put32( result, frame.X );
+            Put32( result, frame.Y );
+            Put32( result, frame.Width );
+            Put32( result, frame.Height );
+            Put16( result, static_cast<uint16_t>( frame.OffsetX ) );
+            Put16( result, static_cast<uint16_t>( frame.OffsetY ) );
+            Put32( result, static_cast<uint32_t>( frame.HotspotX ) );
+            Put32( result, static_cast<uint32_t>( frame.HotspotY ) );
+        }
+
+        return result;
+    }
+
+    std::string SidecarWrite( const Sidecar& sidecar, SidecarFormat format, const std::string& basename, SinkFactory* sinks /* = nullptr */ )
+    {
+        if( format == SidecarFormat::None )
+            return {};
+
+        std::string          filename = basename;
+        std::vector<uint8_t> content;
+        if( format == SidecarFormat::Json )
+        {
+            const std::string json = SidecarToJson( sidecar );
+
+            filename += ".json";
+            content.assign( json.begin(), json.end() );
+        }
+        else
+        {
+            filename += ".meta";
+            content = SidecarToBinary( sidecar );
+        }
+
+        std::unique_ptr<Sink> sink = CreateFileSink( sinks, filename, content.size() );
+        sink->write( content.data(), content.size() );
+        sink->close();
+
+        return filename;
+    }
+}
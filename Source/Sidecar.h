@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "Sink.h"
+
+namespace frm2png
+{
+    enum class SidecarFormat : uint8_t
+    {
+        None,
+        Json,
+        Binary
+    };
+
+    bool SidecarFormatFromString( const std::string& name, SidecarFormat& format );
+
+    // area of image used by single direction
+    struct SidecarDirection
+    {
+        uint32_t Index;
+        uint32_t X, Y, Width, Height;
+
+        // position of first frame, as found by ConvertOffsets()
+        int32_t ShiftX, ShiftY;
+    };
+
+    struct SidecarFrame
+    {
+        uint32_t Direction, Frame;
+
+        // position of frame in image
+        uint32_t X, Y, Width, Height;
+
+        // original .frm offsets
+        int16_t OffsetX, OffsetY;
+
+        // position of .frm hotspot in image
+        int32_t HotspotX, HotspotY;
+    };
+
+    // describes how frames are placed in generated image, so it can be used without .frm file
+    struct Sidecar
+    {
+        std::string Image;
+        uint32_t    Width = 0, Height = 0;
+
+        uint16_t FramesPerSecond    = 0;
+        uint16_t ActionFrame        = 0;
+        uint16_t FramesPerDirection = 0;
+
+        std::vector<SidecarDirection> Directions;
+        std::vector<SidecarFrame>     Frames;
+    };
+
+    std::string SidecarToJson( const Sidecar& sidecar );
+
+    // all values are little-endian
+    //   char[4]  "FRMM"
+    //   uint32   version (1)
+    //   uint32   width, height
+    //   uint16   frames per second, action frame, frames per direction
+    //   uint16   image name length, followed by image name (no terminator)
+    //   uint32   directions count, frames count
+    //   directions: uint32 index, x, y, width, height; int32 shift x, shift y
+    //   frames:     uint32 direction, frame, x, y, width, height; int16 offset x, offset y; int32 hotspot x, hotspot y
+    static constexpr char     SidecarMagic[4] = { 'F', 'R', 'M', 'M' };
+    static constexpr uint32_t SidecarVersion  = 1;
+
+    std::vector<uint8_t> SidecarToBinary( const Sidecar& sidecar );
+
+    // writes sidecar as 'basename.json' or 'basename.meta'; returns its filename
+    // if factory is set, it creates sink for file instead of writing to disk
+    std::string SidecarWrite( const Sidecar& sidecar, SidecarFormat format, const std::string& basename, SinkFactory* sinks = nullptr );
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// frm2png includes
+#include "Sink.h"
+
+namespace frm2png
+{
+    //
+    // MemorySink
+    //
+
+    MemorySink::MemorySink( std::size_t reserve /* = 0 */ )
+    {
+        _buffer.reserve( reserve );
+    }
+
+    void MemorySink::write( const uint8_t* data, std::size_t length )
+    {
+        if( _closed )
+            throw std::runtime_error( "MemorySink::write() - Sink already closed" );
+
+        _buffer.insert( _buffer.end(), data, data + length );
+    }
+
+    void MemorySink::close()
+    {
+        _closed = true;
+    }
+
+    bool MemorySink::closed() const
+    {
+        return _closed;
+    }
+
+    const std::vector<uint8_t>& MemorySink::buffer() const
+    {
+        return _buffer;
+    }
+
+    std::vector<uint8_t> MemorySink::release()
+    {
+        std::vector<uint8_t> result = std::move( _buffer );
+        _buffer.clear();
+
+        return result;
+    }
+
+    //
+    // FileSink
+    //
+
+    FileSink::FileSink( const std::string& filename, std::size_t reserve /* = 0 */ ) :
+        MemorySink( reserve ),
+        _filename( filename )
+    {}
+
+    void FileSink::close()
+    {
+        if( _closed )
+            return;
+
+        MemorySink::close();
+
+        ReplaceFile( _filename, _buffer.data(), _buffer.size() );
+    }
+
+    const std::string& FileSink::filename() const
+    {
+        return _filename;
+    }
+
+    //
+    // MemorySinkFactory
+    //
+
+    // passes buffer to factory when closed
+    class FactorySink : public MemorySink
+    {
+    protected:
+        MemorySinkFactory& _factory;
+        std::string        _filename;
+
+    public:
+        FactorySink( MemorySinkFactory& factory, const std::string& filename, std::size_t reserve ) :
+            MemorySink( reserve ),
+            _factory( factory ),
+            _filename( filename )
+        {}
+
+        virtual void close() override
+        {
+            if( _closed )
+                return;
+
+            MemorySink::close();
+            _factory.add( _filename, release() );
+        }
+    };
+
+    std::unique_ptr<Sink> MemorySinkFactory::create( const std::string& filename, std::size_t reserve /* = 0 */ )
+    {
+        return std::unique_ptr<Sink>( new FactorySink( *this, filename, reserve ) );
+    }
+
+    void MemorySinkFactory::add( const std::string& filename, std::vector<uint8_t>&& content )
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        // same as with files on disk, writing file again replaces previous content
+        auto it = std::find_if( _files.begin(), _files.end(), [&filename]( const std::pair<std::string, std::vector<uint8_t>>& file ) { return file.first == filename; } );
+        if( it != _files.end() )
+            it->second = std::move( content );
+        else
+            _files.emplace_back( filename, std::move( content ) );
+    }
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> MemorySinkFactory::release()
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> result = std::move( _files );
+        _files.clear();
+
+        return result;
+    }
+
+    std::unique_ptr<Sink> CreateFileSink( SinkFactory* factory, const std::string& filename, std::size_t reserve /* = 0 */ )
+    {
+        if( factory )
+            return factory->create( filename, reserve );
+
+        return std::unique_ptr<Sink>( new FileSink( filename, reserve ) );
+    }
+
+    void ReplaceFile( const std::string& filename, const uint8_t* data, std::size_t length )
+    {
+        // existing file is replaced rather than overwritten, so it's never modified if hardlinked elsewhere (see OutputCache)
+        std::remove( filename.c_str() );
+
+        std::ofstream stream( filename, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary );
+        if( !stream.is_open() )
+            throw std::runtime_error( "ReplaceFile() - Can't open output file: " + filename );
+
+        // whole file goes out in one go, large buffers bypass stream buffering entirely
+        stream.write( reinterpret_cast<const char*>( data ), static_cast<std::streamsize>( length ) );
+        stream.close();
+
+        if( !stream )
+            throw std::runtime_error( "ReplaceFile() - Can't write output file: " + filename );
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace frm2png
+{
+    // receives encoded output, one file at a time
+    class Sink
+    {
+    public:
+        virtual ~Sink() = default;
+
+        virtual void write( const uint8_t* data, std::size_t length ) = 0;
+
+        // called once, after last write(); file is complete at this point
+        virtual void close() = 0;
+    };
+
+    // collects whole encoded file in growable memory buffer
+    class MemorySink : public Sink
+    {
+    protected:
+        std::vector<uint8_t> _buffer;
+        bool                 _closed = false;
+
+    public:
+        MemorySink( std::size_t reserve = 0 );
+
+        virtual void write( const uint8_t* data, std::size_t length ) override;
+        virtual void close() override;
+
+        bool                        closed() const;
+        const std::vector<uint8_t>& buffer() const;
+
+        // moves buffer out of sink; caller takes over encoded bytes
+        std::vector<uint8_t> release();
+    };
+
+    // collects whole encoded file in memory, creates file on disk with a single write when closed
+    // nothing is written if sink is destroyed without being closed (e.g. after encoding error)
+    class FileSink : public MemorySink
+    {
+    protected:
+        std::string _filename;
+
+    public:
+        FileSink( const std::string& filename, std::size_t reserve = 0 );
+
+        virtual void close() override;
+
+        const std::string& filename() const;
+    };
+
+    // creates sinks for output files; allows writers to put files somewhere else than on disk
+    class SinkFactory
+    {
+    public:
+        virtual ~SinkFactory() = default;
+
+        virtual std::unique_ptr<Sink> create( const std::string& filename, std::size_t reserve = 0 ) = 0;
+    };
+
+    // keeps closed files in memory instead of writing them; safe to use by multiple threads
+    class MemorySinkFactory : public SinkFactory
+    {
+    protected:
+        std::mutex                                                _lock;
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> _files;
+
+    public:
+        virtual std::unique_ptr<Sink> create( const std::string& filename, std::size_t reserve = 0 ) override;
+
+        // called by created sinks when closed
+        void add( const std::string& filename, std::vector<uint8_t>&& content );
+
+        // moves out all files closed so far, in order of completion; filename + content
+        // file closed again under same name keeps its original position
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> release();
+    };
+
+    // uses factory if set, FileSink otherwise
+    std::unique_ptr<Sink> CreateFileSink( SinkFactory* factory, const std::string& filename, std::size_t reserve = 0 );
+
+    // creates file with given content, removing existing one first
+    void ReplaceFile( const std::string& filename, const uint8_t* data, std::size_t length );
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// frm2png includes
+#include "Split.h"
+
+namespace frm2png
+{
+    std::vector<std::string> SplitList( const std::string& list, char separator /* = ',' */ )
+    {
+        std::vector<std::string> result;
+        std::size_t              start = 0, pos;
+
+        do
+        {
+            pos = list.find( separator, start );
+            result.push_back( list.substr( start, pos == std::string::npos ? std::string::npos : pos - start ) );
+            start = pos + 1;
+        }
+        while( pos != std::string::npos );
+
+        return result;
+    }
+
+    void SplitFilename( const std::string& full, std::string& path, std::string& basename, std::string& extension )
+    {
+        const std::size_t slash    = full.find_last_of( '/' );
+        const std::string filename = slash != std::string::npos ? full.substr( slash + 1 ) : full;
+        const std::size_t dot      = filename.find_last_of( '.' );
+
+        path      = slash != std::string::npos ? full.substr( 0, slash + 1 ) : "";
+        basename  = filename.substr( 0, dot );
+        extension = dot != std::string::npos ? filename.substr( dot ) : "";
+
+        if( path == "./" )
+            path.clear();
+    }
+}
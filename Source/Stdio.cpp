@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// system includes
+#if defined( _WIN32 )
+    #include <fcntl.h>
+    #include <io.h>
+#else
+    #include <cerrno>
+    #include <unistd.h>
+#endif
+
+// frm2png includes
+#include "Stdio.h"
+
+namespace frm2png
+{
+    const char* const StdioFilename = "-";
+
+    // descriptor of original stdout, see ReserveStdout()
+    static int Stdout = -1;
+
+    bool IsStdio( const std::string& filename )
+    {
+        return filename == StdioFilename;
+    }
+
+    static std::vector<char> ReadAll( std::FILE* file )
+    {
+#if defined( _WIN32 )
+        _setmode( _fileno( file ), _O_BINARY );
+#endif
+
+        std::vector<char> content;
+        char              chunk[64 * 1024];
+        std::size_t       length;
+
+        while( ( length = std::fread( chunk, 1, sizeof( chunk ), file ) ) > 0 )
+            content.insert( content.end(), chunk, chunk + length );
+
+        if( std::ferror( file ) )
+            throw std::runtime_error( "ReadStdin() - Can't read stdin" );
+
+        return content;
+    }
+
+    const std::vector<char>& ReadStdin()
+    {
+        static const std::vector<char> content = ReadAll( stdin );
+
+        return content;
+    }
+
+    void ReserveStdout()
+    {
+        if( Stdout >= 0 )
+            return;
+
+        std::cout.flush();
+        std::fflush( stdout );
+
+#if defined( _WIN32 )
+        Stdout = _dup( _fileno( stdout ) );
+        if( Stdout < 0 || _dup2( _fileno( stderr ), _fileno( stdout ) ) != 0 )
+            throw std::runtime_error( "ReserveStdout() - Can't redirect stdout" );
+
+        _setmode( Stdout, _O_BINARY );
+#else
+        Stdout = dup( STDOUT_FILENO );
+        if( Stdout < 0 || dup2( STDERR_FILENO, STDOUT_FILENO ) < 0 )
+            throw std::runtime_error( "ReserveStdout() - Can't redirect stdout" );
+#endif
+    }
+
+    static void Write( const char* data, std::size_t size )
+    {
+        while( size > 0 )
+        {
+#if defined( _WIN32 )
+            int length = _write( Stdout, data, static_cast<unsigned>( std::min<std::size_t>( size, 0x40000000 ) ) );
+#else
+            ssize_t length = write( Stdout, data, size );
+            if( length < 0 && errno == EINTR )
+                continue;
+#endif
+            if( length <= 0 )
+                throw std::runtime_error( "Write() - Can't write to stdout" );
+
+            data += length;
+            size -= static_cast<std::size_t>( length );
+        }
+    }
+
+    // ustar header; numbers are octal, zero-terminated
+    static void WriteTarHeader( const std::string& filename, std::size_t size, std::time_t mtime )
+    {
+        char header[512] = {};
+
+        // longer names are split between prefix and name fields
+        std::string prefix, name = filename;
+        if( name.size() > 100 )
+        {
+            std::size_t pos = name.find_last_of( '/', 155 );
+            if( pos == std::string::npos || name.size() - pos - 1 > 100 )
+                throw std::runtime_error( "WriteTarHeader() - Filename too long for tar archive: " + filename );
+
+            prefix = name.substr( 0, pos );
+            name   = name.substr( pos + 1 );
+        }
+
+        std::memcpy( header, name.data(), name.size() );
+        std::snprintf( header + 100, 8, "%07o", 0644u );                                             // mode
+        std::snprintf( header + 108, 8, "%07o", 0u );                                                // uid
+        std::snprintf( header + 116, 8, "%07o", 0u );                                                // gid
+        std::snprintf( header + 124, 12, "%011llo", static_cast<unsigned long long>( size ) );       // size
+        std::snprintf( header + 136, 12, "%011llo", static_cast<unsigned long long>( mtime ) );      // mtime
+        std::memset( header + 148, ' ', 8 );                                                         // checksum, counted as spaces
+        header[156] = '0';                                                                           // regular file
+        std::memcpy( header + 257, "ustar", 6 );                                                     // magic
+        std::memcpy( header + 263, "00", 2 );                                                        // version
+        std::memcpy( header + 345, prefix.data(), prefix.size() );
+
+        unsigned checksum = 0;
+        for( char c : header )
+            checksum += static_cast<unsigned char>( c );
+
+        std::snprintf( header + 148, 8, "%06o", checksum );
+
+        Write( header, sizeof( header ) );
+    }
+
+    static const char Padding[1024] = {};
+
+    StdoutWriter::StdoutWriter( bool tar ) :
+        _tar( tar ),
+        _mtime( std::time( nullptr ) )
+    {
+        if( Stdout < 0 )
+            throw std::runtime_error( "StdoutWriter::StdoutWriter() - Stdout is not reserved" );
+    }
+
+    void StdoutWriter::add( std::size_t index, Files&& files )
+    {
+        if( !_tar && files.size() != 1 )
+            throw std::runtime_error( "StdoutWriter::add() - Input produced " + std::to_string( files.size() ) + " files, use --tar to write them to stdout" );
+
+        std::lock_guard<std::mutex> lock( _lock );
+
+        // inputs finished out of order wait for previous ones
+        if( index != _next )
+        {
+            _pending.emplace( index, std::move( files ) );
+            return;
+        }
+
+        write( files );
+        _next++;
+
+        for( auto it = _pending.begin(); it != _pending.end() && it->first == _next; it = _pending.erase( it ) )
+        {
+            write( it->second );
+            _next++;
+        }
+    }
+
+    void StdoutWriter::finish()
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        if( !_pending.empty() )
+            throw std::runtime_error( "StdoutWriter::finish() - Outputs of some inputs are missing" );
+
+        // end of archive
+        if( _tar )
+            Write( Padding, sizeof( Padding ) );
+    }
+
+    void StdoutWriter::write( const Files& files )
+    {
+        for( const auto& file : files )
+        {
+            if( _tar )
+                WriteTarHeader( file.first, file.second.size(), _mtime );
+
+            Write( reinterpret_cast<const char*>( file.second.data() ), file.second.size() );
+
+            if( _tar )
+                Write( Padding, ( 512 - file.second.size() % 512 ) % 512 );
+        }
+    }
+}
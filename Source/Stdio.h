@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace frm2png
+{
+    // used instead of filename, to read input from stdin or write output to stdout
+    extern const char* const StdioFilename;
+
+    bool IsStdio( const std::string& filename );
+
+    // reads whole stdin on first call; later calls return same content; safe to use by multiple threads
+    const std::vector<char>& ReadStdin();
+
+    // keeps stdout for output files only; everything printed after that (info, logging, warnings) goes to stderr
+    void ReserveStdout();
+
+    // writes output files of each input to stdout as soon as outputs of all previous inputs are written; safe to use by multiple threads
+    // ReserveStdout() must be called first
+    class StdoutWriter
+    {
+    protected:
+        typedef std::vector<std::pair<std::string, std::vector<uint8_t>>> Files;
+
+        const bool        _tar;
+        const std::time_t _mtime;
+
+        std::mutex                   _lock;
+        std::size_t                  _next = 0;
+        std::map<std::size_t, Files> _pending;
+
+    public:
+        // tar writes every file as archive entry; otherwise each input must produce single file, written as-is
+        StdoutWriter( bool tar );
+
+        StdoutWriter( const StdoutWriter& ) = delete;
+        StdoutWriter& operator=( const StdoutWriter& ) = delete;
+
+        // index is position of input in original order, starting from 0; files are filename + content
+        void add( std::size_t index, Files&& files );
+
+        // ends tar archive; must be called after outputs of all inputs are added
+        void finish();
+
+    protected:
+        void write( const Files& files );
+    };
+}
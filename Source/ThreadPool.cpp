@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// C++ standard includes
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// frm2png includes
+#include "ThreadPool.h"
+
+namespace frm2png
+{
+    // identifies worker threads; index is valid only if pool matches
+    static thread_local const ThreadPool* WorkerPool  = nullptr;
+    static thread_local std::size_t       WorkerIndex = 0;
+
+    static constexpr std::size_t NotWorker = static_cast<std::size_t>( -1 );
+
+    ThreadPool::ThreadPool( std::size_t threads /* = 0 */ ) :
+        _pending( 0 ),
+        _events( 0 )
+    {
+        if( !threads )
+            threads = std::max<std::size_t>( 1, std::thread::hardware_concurrency() );
+
+        // single thread pool runs everything in calling thread
+        if( threads == 1 )
+            return;
+
+        for( std::size_t t = 0; t < threads; t++ )
+        {
+            _queues.emplace_back( new Queue );
+        }
+
+        for( std::size_t t = 0; t < threads; t++ )
+        {
+            _threads.emplace_back( &ThreadPool::worker, this, t );
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _stop = true;
+        }
+        _condition.notify_all();
+
+        for( auto& thread : _threads )
+        {
+            thread.join();
+        }
+    }
+
+    std::size_t ThreadPool::size() const
+    {
+        return std::max<std::size_t>( 1, _threads.size() );
+    }
+
+    bool ThreadPool::runPending()
+    {
+        std::function<void()> task;
+        const std::size_t     index = WorkerPool == this ? WorkerIndex : NotWorker;
+
+        if( !pop( index, index == NotWorker, task ) )
+            return false;
+
+        task();
+
+        return true;
+    }
+
+    void ThreadPool::push( std::function<void()>&& task )
+    {
+        Queue& queue = WorkerPool == this ? *_queues[WorkerIndex] : _shared;
+
+        // counted before task is visible, so it never drops below zero
+        _pending++;
+
+        {
+            std::lock_guard<std::mutex> lock( queue.Mutex );
+            queue.Tasks.push_back( std::move( task ) );
+        }
+
+        // sleeping workers check _pending while holding _mutex, so notification can't be missed
+        // threads waiting in ready() may be able to steal new task, so they're woken as well
+        bool waiting;
+        {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _events++;
+            waiting = _waiting != 0;
+        }
+
+        if( waiting )
+            _condition.notify_all();
+        else
+            _condition.notify_one();
+    }
+
+    void ThreadPool::finished()
+    {
+        // result is already set, so thread checking it in ready() either sees it, or is sleeping before lock is taken
+        bool waiting;
+        {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _events++;
+            waiting = _waiting != 0;
+        }
+
+        if( waiting )
+            _condition.notify_all();
+    }
+
+    // order: newest task of own queue, oldest task of shared queue (if allowed), oldest task of other workers queues
+    bool ThreadPool::pop( std::size_t worker, bool shared, std::function<void()>& task )
+    {
+        if( !_pending )
+            return false;
+
+        if( worker != NotWorker )
+        {
+            Queue&                      queue = *_queues[worker];
+            std::lock_guard<std::mutex> lock( queue.Mutex );
+
+            if( !queue.Tasks.empty() )
+            {
+                task = std::move( queue.Tasks.back() );
+                queue.Tasks.pop_back();
+                _pending--;
+
+                return true;
+            }
+        }
+
+        if( shared )
+        {
+            std::lock_guard<std::mutex> lock( _shared.Mutex );
+
+            if( !_shared.Tasks.empty() )
+            {
+                task = std::move( _shared.Tasks.front() );
+                _shared.Tasks.pop_front();
+                _pending--;
+
+                return true;
+            }
+        }
+
+        for( std::size_t offset = 1; offset <= _queues.size(); offset++ )
+        {
+            const std::size_t victim = ( ( worker != NotWorker ? worker : 0 ) + offset ) % _queues.size();
+
+            if( victim == worker )
+                continue;
+
+            Queue&                      queue = *_queues[victim];
+            std::lock_guard<std::mutex> lock( queue.Mutex );
+
+            if( !queue.Tasks.empty() )
+            {
+                task = std::move( queue.Tasks.front() );
+                queue.Tasks.pop_front();
+                _pending--;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::worker( std::size_t index )
+    {
+        WorkerPool  = this;
+        WorkerIndex = index;
+
+        while( true )
+        {
+            std::function<void()> task;
+
+            if( pop( index, true, task ) )
+            {
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock( _mutex );
+            _condition.wait( lock, [this]() { return _stop || _pending; } );
+
+            if( _stop && !_pending )
+                return;
+        }
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019-2021 Rotators
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// C++ standard includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace frm2png
+{
+    // fixed-size pool of worker threads, with work stealing
+    // each worker has its own queue; tasks submitted by worker go to its queue, and are executed newest first by that worker, while idle workers steal oldest ones
+    // tasks submitted by other threads go to shared queue, which is only used by workers without other work, and by non-worker threads
+    // threads waiting for results (including workers) execute queued tasks instead of blocking, which allows tasks to submit and wait for other tasks
+    class ThreadPool
+    {
+    protected:
+        struct Queue
+        {
+            std::mutex                        Mutex;
+            std::deque<std::function<void()>> Tasks;
+        };
+
+        std::vector<std::thread>            _threads;
+        std::vector<std::unique_ptr<Queue>> _queues;
+        Queue                               _shared;
+        std::atomic<std::size_t>            _pending;
+        std::mutex                          _mutex;
+        std::condition_variable             _condition;
+        bool                                _stop = false;
+
+        // incremented under _mutex whenever task is queued or finished; threads waiting in ready() sleep until it changes
+        std::atomic<std::size_t> _events;
+        std::size_t              _waiting = 0;
+
+    public:
+        // 0 = one thread per available core
+        ThreadPool( std::size_t threads = 0 );
+        ThreadPool( const ThreadPool& ) = delete;
+        ThreadPool& operator=( const ThreadPool& ) = delete;
+        ~ThreadPool();
+
+        std::size_t size() const;
+
+        template<typename F>
+        std::future<typename std::result_of<F()>::type> submit( F&& func )
+        {
+            typedef typename std::result_of<F()>::type R;
+
+            auto task   = std::make_shared<std::packaged_task<R()>>( std::forward<F>( func ) );
+            auto result = task->get_future();
+
+            if( _threads.empty() )
+                ( *task )();
+            else
+                push( [this, task]() {
+                    ( *task )();
+                    finished();
+                } );
+
+            return result;
+        }
+
+        // runs queued tasks until result is ready; sleeps when there's nothing to run, until another task is queued or finished
+        template<typename T>
+        void ready( std::future<T>& result )
+        {
+            auto done = [&result]() { return result.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready; };
+
+            while( !done() )
+            {
+                const std::size_t events = _events;
+
+                if( runPending() )
+                    continue;
+
+                std::unique_lock<std::mutex> lock( _mutex );
+                _waiting++;
+                _condition.wait( lock, [this, events, &done]() { return _events != events || done(); } );
+                _waiting--;
+            }
+        }
+
+        // runs queued tasks until result is ready, then returns it
+        template<typename T>
+        T wait( std::future<T>& result )
+        {
+            ready( result );
+
+            return result.get();
+        }
+
+        // executes single queued task in calling thread; returns false if there was nothing to run
+        // workers run their own tasks first, then steal oldest tasks of other workers, which can be subtasks of unrelated work
+        // (e.g. directions of another file); only shared queue is skipped, so waiting worker never starts new top-level task
+        bool runPending();
+
+    protected:
+        void push( std::function<void()>&& task );
+        void finished();
+        bool pop( std::size_t worker, bool shared, std::function<void()>& task );
+        void worker( std::size_t index );
+    };
+}
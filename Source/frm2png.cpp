@@ -22,16 +22,43 @@
  */
 
 // C++ standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 // frm2png includes
 #include "ColorPal.h"
+#include "Hash.h"
+#include "InputFiles.h"
+#include "InputPrefetch.h"
+#include "Job.h"
+#include "Manifest.h"
+#include "OutputCache.h"
+#include "OutputWriter.h"
+#include "PaletteTable.h"
+#include "PngEncoder.h"
+#include "PngFilter.h"
 #include "PngGenerator.h"
+#include "PngScale.h"
+#include "Server.h"
+#include "Sidecar.h"
+#include "Split.h"
+#include "Stdio.h"
+#include "ThreadPool.h"
 
 // falltergeist includes
 #include "Format/Dat/Stream.h"
@@ -56,13 +83,32 @@ struct Options
     std::string              PalFile;
     std::string              PalName = "default";
     std::vector<std::string> FrmFile;
+    std::string              Jobs;
 
     // output
     std::string Generator = "auto";
     std::string PngFile;
+    std::string OutputDir;
+    bool        Tar = false;
+    std::string Incremental;
+    std::string Cache;
+    std::string Format    = "png";
+    bool        AnimDelta = false;
+    std::string Filter    = "sum";
+    unsigned    Optimize  = 0;
+    std::string Metadata  = "none";
+    std::string Batch;
+    unsigned    PageSize  = 1024;
+    unsigned    MaxPages  = 0;
+    unsigned    Thumbnail = 64;
+    unsigned    Scale     = 1;
+
+    // server
+    std::string Server;
 
     // misc
-    bool Verbose = false;
+    bool     Verbose = false;
+    unsigned Threads = 0;
 
     Options()
     {}
@@ -81,34 +127,66 @@ struct Options
         auto cmdInput =
         (
         //  (clipp::option( "-d", "--dat" ) & clipp::value( "DAT", DatFile )).doc( "Use specified DAT file" ),
-            (clipp::option( "-p", "--pal" ) & clipp::value( "PAL", PalFile )).doc( "Use specified PAL file" ) |
+            (clipp::option( "-p", "--pal" ) & clipp::value( "PAL", PalFile )).doc( "Use specified PAL file; '-' reads it from stdin" ) |
             (clipp::option( "-P", "--palette" ) & clipp::value( "name", PalName )).doc( "Use embedded palette" )
         )
         .doc( "Input options" );
 
         auto cmdOutput =
         (
-            (clipp::option( "-g", "--generator" ) & clipp::value( "name", Generator )).doc( "generator" ),
-            (clipp::option( "-o", "--output" ) & clipp::value( "PNG", PngFile )).doc( "output filename" )
+            (clipp::option( "-g", "--generator" ) & clipp::value( "name", Generator )).doc( "generator; comma separated list runs all of them" ),
+            (clipp::option( "-o", "--output" ) & clipp::value( "PNG", PngFile )).doc( "output filename; '-' writes to stdout (default when input is '-')" ),
+            clipp::option( "--tar" ).set( Tar ).doc( "write outputs to stdout as tar archive; used automatically for more than one input, generator or format, for generators writing file per direction (anim, auto), or with metadata" ),
+            (clipp::option( "--output-dir" ) & clipp::value( "dir", OutputDir )).doc( "write output files into directory, recreating layout of input directories" ),
+            (clipp::option( "--incremental" ) & clipp::value( "manifest", Incremental )).doc( "skip files converted by previous run with same settings, if their outputs still exist; results are stored in manifest file" ),
+            (clipp::option( "--cache" ) & clipp::value( "dir", Cache )).doc( "reuse outputs of identical files converted with same settings, stored in cache directory; can be shared between workspaces" ),
+            (clipp::option( "--format" ) & clipp::value( "name", Format )).doc( "output format: png (default), qoi (animations as sprite sheet), qoi-frames (animations as files sequence); comma separated list writes all of them, with metadata named after each image (name.png.json)" ),
+            clipp::option( "--delta" ).set( AnimDelta ).doc( "APNG frames store only area changed since previous frame" ),
+            (clipp::option( "--filter" ) & clipp::value( "mode", Filter )).doc( "rows filter selection: sum (default), none, paletted, brute" ),
+            (clipp::option( "--optimize" ) & clipp::value( "N", Optimize )).doc( "try N encoder settings (max 16) and keep smallest result" ),
+            (clipp::option( "--metadata" ) & clipp::value( "format", Metadata )).doc( "write frames placement next to each image: none (default), json, binary; not available for qoi-frames" ),
+            (clipp::option( "--atlas-batch" ) & clipp::value( "name", Batch )).doc( "pack frames of all files into shared images (name_P.png) described by name.json; generator is not used" ),
+            (clipp::option( "--page-size" ) & clipp::value( "N", PageSize )).doc( "size of --atlas-batch images (default: 1024)" ),
+            (clipp::option( "--max-pages" ) & clipp::value( "N", MaxPages )).doc( "fail if --atlas-batch needs more than N images (default: 0, no limit)" ),
+            (clipp::option( "--scale" ) & clipp::value( "N", Scale )).doc( "upscale frames using Scale2x (2) or Scale3x (3) before running generators" ),
+            (clipp::option( "--thumbnail-size" ) & clipp::value( "N", Thumbnail )).doc( "longest side of 'thumbnail' and 'thumbnail-strip' images (default: 64)" )
         )
         .doc( "Output options" );
 
+        auto cmdJobs =
+        (
+            (clipp::required( "--jobs" ) & clipp::value( "file", Jobs )).doc( "convert files listed in jobs file, one per line; each job can override palette, generator, output and other options" )
+        );
+
+        auto cmdServer =
+        (
+            (clipp::required( "--server" ) & clipp::value( "socket", Server )).doc( "convert files on request received over unix domain socket, keeping loaded files in memory between requests" )
+        )
+        .doc( "Server options" );
+
         auto cmdMisc =
         (
             clipp::option( "-V", "--verbose" ).set( Verbose ).doc( "prints various debug messages" ),
+            (clipp::option( "-j", "--threads" ) & clipp::value( "N", Threads )).doc( "number of worker threads; multiple files are converted in parallel (default: one per core)" ),
             clipp::option( "-i", "--info" ).set( Info ).doc( "prints FRM info only (doesn't process files)" )
         )
         .doc( "Misc options" );
 
         // clang-format on
 
-        CommandLine = ( cmdInfo | ( cmdInput, cmdOutput, cmdMisc, clipp::values( "filename.frm", FrmFile ) ) );
+        CommandLine = ( cmdInfo | ( cmdServer, cmdMisc ) | ( cmdInput, cmdOutput, cmdMisc, ( cmdJobs | clipp::values( "filename.frm|directory|pattern", FrmFile ) ) ) );
     }
 };
 
+static const char* ProgramVersion = "0.1.5r";
+
+// must be increased by every change which makes same input and options produce different output files
+// part of --incremental and --cache keys, so outputs written by other builds are never reused when they would differ
+static const unsigned OutputRevision = 2;
+
 static void printVersion()
 {
-    std::cout << "FRM to PNG converter v0.1.5r" << std::endl
+    std::cout << "FRM to PNG converter v" << ProgramVersion << std::endl
               << "Copyright (c) 2015-2018 Falltergeist developers" << std::endl
               << "Copyright (c) 2019-2021 Rotators" << std::endl
               << std::endl;
@@ -143,52 +221,15 @@ static int exitHelp( int exitCode, Options& options )
     return exitCode;
 }
 
-static void printFRM( const std::string& filename, Falltergeist::Format::Frm::File& frm )
+static void printFRM( const std::string& filename, Falltergeist::Format::Frm::File& frm, std::ostream& out )
 {
-    std::cout << "=== FRM info ===" << std::endl;
-    std::cout << "Filename ..............  " << filename << std::endl;
-    std::cout << "Version ................ " << frm.Version << std::endl;
-    std::cout << "Frames per second ...... " << frm.FramesPerSecond << std::endl;
-    std::cout << "Action frame ........... " << frm.ActionFrame << std::endl;
-    std::cout << "Directions ............. " << std::to_string( frm.DirectionsSize() ) << std::endl;
-    std::cout << "Frames per direction ... " << frm.FramesPerDirection << std::endl;
-}
-
-// <- path/to/file.ext
-// -> path/to/
-// -> file
-// -> .ext
-static void splitFilename( const std::string& full, std::string& path, std::string& basename, std::string& extension )
-{
-    size_t      pos;
-    std::string filename;
-
-    pos = full.find_last_of( '/' );
-    if( pos != std::string::npos )
-    {
-        path     = full.substr( 0, pos + 1 );
-        filename = full.substr( pos + 1 );
-
-        if( path == "./" )
-            path.clear();
-    }
-    else
-    {
-        path     = "";
-        filename = full;
-    }
-
-    pos = filename.find_last_of( '.' );
-    if( pos != std::string::npos )
-    {
-        basename  = filename.substr( 0, pos );
-        extension = filename.substr( pos );
-    }
-    else
-    {
-        basename  = filename;
-        extension = "";
-    }
+    out << "=== FRM info ===" << std::endl;
+    out << "Filename ..............  " << filename << std::endl;
+    out << "Version ................ " << frm.Version << std::endl;
+    out << "Frames per second ...... " << frm.FramesPerSecond << std::endl;
+    out << "Action frame ........... " << frm.ActionFrame << std::endl;
+    out << "Directions ............. " << std::to_string( frm.DirectionsSize() ) << std::endl;
+    out << "Frames per direction ... " << frm.FramesPerDirection << std::endl;
 }
 
 template<typename T>
@@ -205,9 +246,25 @@ T loadFile( const std::string& filename )
     return obj;
 }
 
+static Falltergeist::Format::Frm::File loadFrm( const std::string& filename )
+{
+    if( IsStdio( filename ) )
+    {
+        const std::vector<char>& content = ReadStdin();
+        return Falltergeist::Format::Frm::File( Falltergeist::Format::Dat::Stream( content.data(), content.size() ) );
+    }
+
+    return loadFile<Falltergeist::Format::Frm::File>( filename );
+}
+
 static Falltergeist::Format::Pal::File loadPal( const Options& options )
 {
-    if( !options.PalFile.empty() )
+    if( IsStdio( options.PalFile ) )
+    {
+        const std::vector<char>& content = ReadStdin();
+        return Falltergeist::Format::Pal::File( Falltergeist::Format::Dat::Stream( content.data(), content.size() ) );
+    }
+    else if( !options.PalFile.empty() )
         return loadFile<Falltergeist::Format::Pal::File>( options.PalFile );
 
     std::string palName = options.PalName;
@@ -225,12 +282,283 @@ static Falltergeist::Format::Pal::File loadPal( const Options& options )
     throw std::runtime_error( "loadPal() - unknown palette name '" + palName + "'" );
 }
 
+// hash of palette and options affecting content of outputs; combined with .frm content, it decides if file needs to be converted again
+static uint64_t getSettingsHash( const Options& options, const PaletteTable& palette )
+{
+    std::string settings = std::string( ProgramVersion ) + "\n" +
+                           std::to_string( OutputRevision ) + "\n" +
+                           options.Generator + "\n" +
+                           options.Format + "\n" +
+                           ( options.AnimDelta ? "delta" : "" ) + "\n" +
+                           options.Filter + "\n" +
+                           std::to_string( options.Optimize ) + "\n" +
+                           options.Metadata + "\n" +
+                           std::to_string( options.Thumbnail ) + "\n" +
+                           std::to_string( options.Scale ) + "\n";
+
+    settings.append( reinterpret_cast<const char*>( palette.Colors ), sizeof( palette.Colors ) );
+
+    return HashString( settings );
+}
+
+// settings shared by all converted files
+struct Conversion
+{
+    PngGeneratorOutput        Output;
+    std::vector<OutputFormat> Formats;
+
+    // loaded once, shared by all files
+    std::shared_ptr<const PaletteTable> Palette;
+
+    // if set, files are added to batch instead of running generators
+    AtlasBatch* Batch = nullptr;
+
+    // if set, unchanged files are skipped (--incremental)
+    Manifest* Incremental = nullptr;
+
+    // if set, outputs are restored from cache when possible, and stored in cache after conversion (--cache)
+    OutputCache* Cache = nullptr;
+
+    // if set, outputs are written to stdout instead of files (-o -)
+    StdoutWriter* Stdout = nullptr;
+
+    // see getSettingsHash()
+    uint64_t Settings = 0;
+};
+
+enum class ConvertResult : uint8_t
+{
+    Converted,
+    Unchanged, // skipped, see Conversion::Incremental
+    Cached     // outputs restored, see Conversion::Cache
+};
+
+// converts single .frm file; safe to run in parallel for different files when batch is not used
+static ConvertResult convertFile( const Options& options, const Conversion& conversion, const PrefetchedFile& file, Logging& logVerbose, std::ostream& out )
+{
+    const InputFile&   input   = file.Input;
+    const std::string& frmFile = input.Filename;
+
+    // split output filename into few parts; helps generators to modify filename provided by user
+
+    std::string pngFull, pngPath, pngBasename, pngExtension;
+
+    if( IsStdio( options.PngFile ) )
+    {
+        // files written to stdout are named after input, in case they end up in tar archive
+        std::string frmPath, frmBasename, frmExtension;
+        SplitFilename( IsStdio( frmFile ) ? "stdin" : frmFile, frmPath, frmBasename, frmExtension );
+
+        pngFull = frmBasename + OutputFormatExtension( conversion.Formats.front() );
+    }
+    else if( !options.PngFile.empty() )
+        pngFull = options.PngFile;
+    else
+    {
+        std::string frmPath, frmBasename, frmExtension;
+
+        if( options.OutputDir.empty() )
+            SplitFilename( frmFile, frmPath, frmBasename, frmExtension );
+        else
+            SplitFilename( options.OutputDir + "/" + input.Relative, frmPath, frmBasename, frmExtension );
+
+        pngFull = frmPath + frmBasename + OutputFormatExtension( conversion.Formats.front() );
+    }
+
+    SplitFilename( pngFull, pngPath, pngBasename, pngExtension );
+
+    // manifest key depends on output location, cache key only on name of output, as it can be stored inside outputs
+
+    uint64_t    frmHash = 0;
+    std::string manifestKey, cacheKey;
+
+    if( ( conversion.Incremental || conversion.Cache ) && !options.Info )
+        frmHash = file.Content ? HashBytes( file.Content->data(), file.Content->size() ) : HashFile( frmFile );
+
+    if( conversion.Incremental && !options.Info )
+    {
+        manifestKey = HashToString( HashCombine( HashString( pngFull + "\n" + input.Relative, conversion.Settings ), frmHash ) );
+
+        if( conversion.Incremental->unchanged( frmFile, manifestKey ) )
+        {
+            logVerbose << "unchanged = " + frmFile;
+            return ConvertResult::Unchanged;
+        }
+    }
+
+    if( !options.OutputDir.empty() && !options.Info && !conversion.Batch )
+        CreateDirectories( pngPath );
+
+    if( conversion.Cache && !options.Info )
+    {
+        cacheKey = HashToString( HashCombine( HashString( pngBasename + pngExtension, conversion.Settings ), frmHash ) );
+
+        std::vector<std::string> outputs;
+        if( conversion.Cache->restore( cacheKey, pngPath + pngBasename, outputs ) )
+        {
+            logVerbose << "cached = " + frmFile + " -> " + cacheKey;
+
+            if( conversion.Incremental )
+                conversion.Incremental->update( frmFile, manifestKey, outputs );
+
+            return ConvertResult::Cached;
+        }
+    }
+
+    PngGeneratorData data( file.Content ? Falltergeist::Format::Frm::File( Falltergeist::Format::Dat::Stream( file.Content->data(), file.Content->size() ) ) : loadFrm( frmFile ), conversion.Palette );
+
+    printFRM( frmFile, data.Frm, out );
+
+    if( options.Info )
+        return ConvertResult::Converted;
+
+    static_cast<PngGeneratorOutput&>( data ) = conversion.Output;
+
+    data.PngPath      = pngPath;
+    data.PngBasename  = pngBasename;
+    data.PngExtension = pngExtension;
+
+    logVerbose << "png = path[" + data.PngPath + "] basename[" + data.PngBasename + "] extension[" + data.PngExtension + "]";
+
+    if( options.Scale != 1 )
+    {
+        logVerbose << "scale = " + std::to_string( options.Scale );
+        PngScaleFrm( data.Frm, static_cast<uint8_t>( options.Scale ), data.Pool );
+    }
+
+    if( conversion.Batch )
+    {
+        conversion.Batch->add( frmFile, data, logVerbose );
+        return ConvertResult::Converted;
+    }
+
+    PngOutputList outputs;
+    if( conversion.Incremental || conversion.Cache )
+        data.Outputs = &outputs;
+
+    MemorySinkFactory stdoutFiles;
+    if( conversion.Stdout )
+        data.Sinks = &stdoutFiles;
+
+    RunPngGenerators( data, SplitList( options.Generator ), conversion.Formats, logVerbose );
+
+    if( conversion.Stdout )
+    {
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> files = stdoutFiles.release();
+        std::sort( files.begin(), files.end(), []( const std::pair<std::string, std::vector<uint8_t>>& a, const std::pair<std::string, std::vector<uint8_t>>& b ) { return a.first < b.first; } );
+
+        conversion.Stdout->add( file.Index, std::move( files ) );
+    }
+
+    if( conversion.Cache )
+        conversion.Cache->store( cacheKey, pngPath + pngBasename, outputs.files() );
+    if( conversion.Incremental )
+        conversion.Incremental->update( frmFile, manifestKey, outputs.files() );
+
+    return ConvertResult::Converted;
+}
+
+// converts every item returned by next(); results are passed to done() in original order
+// items are converted in parallel by separate tasks, unless pool has single thread or parallel is not set; larger files are split into more tasks during conversion
+// messages are cached, and printed in original order when item is done
+// number of unfinished items is limited, so their messages don't pile up when first one takes long
+template<typename Item>
+static void convertAll( ThreadPool& pool, Logging& logVerbose, bool parallel, const std::function<bool( Item& )>& next, const std::function<ConvertResult( const Item&, Logging&, std::ostream& )>& convert, const std::function<void( ConvertResult )>& done )
+{
+    Item item;
+
+    if( !parallel || pool.size() == 1 )
+    {
+        while( next( item ) )
+            done( convert( item, logVerbose, std::cout ) );
+
+        return;
+    }
+
+    struct ItemTask
+    {
+        Item                       Input;
+        std::unique_ptr<Logging>   Log;
+        std::ostringstream         Out;
+        std::future<ConvertResult> Result;
+    };
+
+    std::deque<ItemTask> tasks;
+    std::atomic<bool>    failed( false );
+    std::exception_ptr   error;
+    const std::size_t    limit = pool.size() * 4;
+
+    // after first error, remaining items are skipped; all tasks must finish before leaving, as they use local variables
+    auto finish = [&pool, &logVerbose, &tasks, &error, &done]() {
+        ItemTask& task = tasks.front();
+        pool.ready( task.Result );
+
+        if( !error )
+        {
+            std::cout << task.Out.str();
+            logVerbose.Replay( *task.Log );
+
+            try
+            {
+                done( task.Result.get() );
+            }
+            catch( ... )
+            {
+                error = std::current_exception();
+            }
+        }
+
+        tasks.pop_front();
+    };
+
+    while( !failed && next( item ) )
+    {
+        tasks.emplace_back();
+
+        ItemTask& task = tasks.back();
+        task.Input     = std::move( item );
+        task.Log.reset( new Logging( logVerbose.Enabled, true, logVerbose.Indent ) );
+
+        task.Result = pool.submit( [&convert, &failed, &task]() {
+            if( failed )
+                return ConvertResult::Converted;
+
+            try
+            {
+                return convert( task.Input, *task.Log, task.Out );
+            }
+            catch( ... )
+            {
+                failed = true;
+                throw;
+            }
+        } );
+
+        while( !tasks.empty() && ( tasks.size() > limit || tasks.front().Result.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready ) )
+            finish();
+    }
+
+    while( !tasks.empty() )
+        finish();
+
+    if( error )
+        std::rethrow_exception( error );
+}
+
 int main( int argc, char** argv )
 {
     Options options;
     options.Init();
 
     auto optionsResult = clipp::parse( argc, argv, options.CommandLine );
+
+    if( options.PngFile.empty() && options.OutputDir.empty() && std::find( options.FrmFile.begin(), options.FrmFile.end(), StdioFilename ) != options.FrmFile.end() )
+        options.PngFile = StdioFilename;
+
+    // output files written to stdout cannot be mixed with messages
+    if( optionsResult && IsStdio( options.PngFile ) && !options.Info )
+        ReserveStdout();
+
     {
         Logging verbose;
 
@@ -252,12 +580,30 @@ int main( int argc, char** argv )
                 << "PalFile   = " + options.PalFile
                 << "PalName   = " + options.PalName
                 << "FrmFile   = " + frmFile
+                << "Jobs      = " + options.Jobs
                 // output
                 << "Generator = " + options.Generator
                 << "PngFile   = " + options.PngFile
+                << "OutputDir = " + options.OutputDir
+                << "Tar       = " + std::string( options.Tar ? "true" : "false" )
+                << "Manifest  = " + options.Incremental
+                << "Cache     = " + options.Cache
+                << "Format    = " + options.Format
+                << "AnimDelta = " + std::string( options.AnimDelta ? "true" : "false" )
+                << "Filter    = " + options.Filter
+                << "Optimize  = " + std::to_string( options.Optimize )
+                << "Metadata  = " + options.Metadata
+                << "Batch     = " + options.Batch
+                << "PageSize  = " + std::to_string( options.PageSize )
+                << "MaxPages  = " + std::to_string( options.MaxPages )
+                << "Thumbnail = " + std::to_string( options.Thumbnail )
+                << "Scale     = " + std::to_string( options.Scale )
+                // server
+                << "Server    = " + options.Server
                 // misc
                 << "Info      = " + std::string( options.Info ? "true" : "false" )
                 << "Verbose   = " + std::string( options.Verbose ? "true" : "false" )
+                << "Threads   = " + std::to_string( options.Threads )
                 << -1;
     }
 
@@ -270,7 +616,30 @@ int main( int argc, char** argv )
 
     try
     {
-        Logging logVerbose( options.Verbose );
+        Logging    logVerbose( options.Verbose );
+        ThreadPool pool( options.Threads );
+
+        logVerbose << "threads = " + std::to_string( pool.size() );
+
+        PngEncoderSettings encoder;
+        if( !PngFilterModeFromString( options.Filter, encoder.Filter ) )
+        {
+            std::cout << "Unknown filter mode: '" << options.Filter << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::vector<OutputFormat> formats;
+        for( const std::string& name : SplitList( options.Format ) )
+        {
+            OutputFormat format;
+            if( !OutputFormatFromString( name, format ) )
+            {
+                std::cout << "Unknown output format: '" << name << "'" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            formats.push_back( format );
+        }
 
         logVerbose << "init generators" << 1;
         InitPngGenerators();
@@ -280,70 +649,244 @@ int main( int argc, char** argv )
         }
         logVerbose << -1;
 
-        logVerbose << "begin frm loop" << 1;
-        for( const std::string& frmFile : options.FrmFile )
+        // everything else is set by requests
+        if( !options.Server.empty() )
         {
-            PngGeneratorData data( loadFile<Falltergeist::Format::Frm::File>( frmFile ), loadPal( options ) );
-
-            printFRM( frmFile, data.Frm );
+            RunServer( options.Server, pool, logVerbose );
+            return EXIT_SUCCESS;
+        }
 
-            if( options.Info )
-                continue;
+        SidecarFormat metadata;
+        if( !SidecarFormatFromString( options.Metadata, metadata ) )
+        {
+            std::cout << "Unknown metadata format: '" << options.Metadata << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            // split output filename into few parts; helps generators to modify filename provided by user
+        // each frame of sequence is separate file, which sidecar cannot describe
+        if( metadata != SidecarFormat::None && std::find( formats.begin(), formats.end(), OutputFormat::QoiFrames ) != formats.end() )
+        {
+            std::cout << "Option --metadata cannot be used with qoi-frames format" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            std::string pngFull;
+        if( options.Scale != 1 && ( options.Scale > UINT8_MAX || !PngScaleFactorSupported( static_cast<uint8_t>( options.Scale ) ) ) )
+        {
+            std::cout << "Unsupported scale factor: '" << options.Scale << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            if( !options.PngFile.empty() )
-                pngFull = options.PngFile;
-            else
+        for( const std::string& generator : SplitList( options.Generator ) )
+        {
+            if( generator != "auto" && Generator.find( generator ) == Generator.end() )
             {
-                std::string frmPath, frmBasename, frmExtension;
-
-                splitFilename( frmFile, frmPath, frmBasename, frmExtension );
-                pngFull = frmPath + frmBasename + ".png";
+                std::cout << "Unknown generator: '" << generator << "'" << std::endl;
+                return EXIT_FAILURE;
             }
+        }
 
-            splitFilename( pngFull, data.PngPath, data.PngBasename, data.PngExtension );
+        if( !options.PngFile.empty() && !options.OutputDir.empty() )
+        {
+            std::cout << "Options -o and --output-dir cannot be used together" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            logVerbose << "png = path[" + data.PngPath + "] basename[" + data.PngBasename + "] extension[" + data.PngExtension + "]";
+        const bool stdinFrm = std::find( options.FrmFile.begin(), options.FrmFile.end(), StdioFilename ) != options.FrmFile.end();
+        const bool stdio    = stdinFrm || IsStdio( options.PalFile ) || IsStdio( options.PngFile );
 
-            // TODO? make rgbMultiplier configurable
-            data.Pal.RGBMultiplier( 4 ); // noon
+        if( stdinFrm && IsStdio( options.PalFile ) )
+        {
+            std::cout << "Input file and palette cannot be both read from stdin" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            // select and run .png generator
-            std::string generator = options.Generator;
-            if( generator == "auto" )
-            {
-                if( data.Frm.DirectionsSize() == 1 )
-                {
-                    if( data.Frm.FramesPerDirection == 1 )
-                        generator = "legacy";
-                    else
-                        generator = "anim";
-                }
-                else
-                    generator = "anim";
+        if( stdio && ( !options.Incremental.empty() || !options.Cache.empty() ) )
+        {
+            std::cout << "Options --incremental and --cache cannot be used with stdin or stdout" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-                logVerbose << "selected generator = " + generator;
-            }
-            else
-                logVerbose << "preselected generator = " + generator;
+        if( IsStdio( options.PngFile ) && !options.Batch.empty() )
+        {
+            std::cout << "Option --atlas-batch cannot write to stdout" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if( options.Tar && !IsStdio( options.PngFile ) )
+        {
+            std::cout << "Option --tar can be used only when writing to stdout" << std::endl;
+            return EXIT_FAILURE;
+        }
 
-            auto itGenerator = Generator.find( generator );
-            if( itGenerator == Generator.end() )
+        if( !options.Jobs.empty() )
+        {
+            if( !options.PngFile.empty() || !options.OutputDir.empty() || !options.Incremental.empty() || !options.Cache.empty() || !options.Batch.empty() || options.Info )
             {
-                std::cout << "Unknown generator: '" << generator << "'" << std::endl;
+                std::cout << "Options -o, --output-dir, --incremental, --cache, --atlas-batch and -i cannot be used with --jobs" << std::endl;
                 return EXIT_FAILURE;
             }
 
-            logVerbose << "start generator = " + generator << 1;
-            itGenerator->second( data, logVerbose );
-            logVerbose << -1 << "end generator = " + generator;
+            std::vector<Job> jobs = ReadJobs( options.Jobs );
+            logVerbose << "jobs = " + std::to_string( jobs.size() );
+
+            // command line options are used for fields not set by job
+            const std::map<std::string, std::string> defaults = {
+                { "generator", options.Generator },
+                { "format", options.Format },
+                { "delta", options.AnimDelta ? "1" : "0" },
+                { "filter", options.Filter },
+                { "optimize", std::to_string( options.Optimize ) },
+                { "metadata", options.Metadata },
+                { "scale", std::to_string( options.Scale ) },
+                { "thumbnail-size", std::to_string( options.Thumbnail ) }
+            };
+
+            for( Job& job : jobs )
+            {
+                job.Fields.insert( defaults.begin(), defaults.end() );
+
+                if( !job.Fields.count( "pal" ) && !job.Fields.count( "palette" ) )
+                {
+                    job.Fields["pal"]     = options.PalFile;
+                    job.Fields["palette"] = options.PalName;
+                }
+            }
+
+            // palettes and archives are loaded once, and shared by all jobs
+            JobSources  sources( 64 * 1024 * 1024 );
+            std::size_t nextJob = 0;
+
+            convertAll<std::size_t>(
+                pool, logVerbose, true,
+                [&jobs, &nextJob]( std::size_t& index ) { index = nextJob++; return index < jobs.size(); },
+                [&options, &jobs, &sources, &pool]( const std::size_t& index, Logging& log, std::ostream& ) {
+                    const Job& job = jobs[index];
+                    log << "job = " + options.Jobs + ":" + std::to_string( job.Line ) << 1;
+
+                    try
+                    {
+                        RunJob( job, sources, pool, nullptr, nullptr, log );
+                    }
+                    catch( std::exception& e )
+                    {
+                        throw std::runtime_error( options.Jobs + ":" + std::to_string( job.Line ) + ": " + e.what() );
+                    }
+
+                    log << -1;
+                    return ConvertResult::Converted;
+                },
+                []( ConvertResult ) {} );
+
+            std::cout << "Jobs completed: " << jobs.size() << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        std::unique_ptr<AtlasBatch> atlasBatch;
+        if( !options.Batch.empty() )
+            atlasBatch.reset( new AtlasBatch( options.PageSize, options.PageSize, options.MaxPages ) );
+
+        if( atlasBatch && ( !options.Incremental.empty() || !options.Cache.empty() ) )
+        {
+            std::cout << "Options --incremental and --cache cannot be used with --atlas-batch" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::unique_ptr<Manifest> manifest;
+        if( !options.Incremental.empty() )
+            manifest.reset( new Manifest( options.Incremental ) );
+
+        std::unique_ptr<OutputCache> cache;
+        if( !options.Cache.empty() )
+            cache.reset( new OutputCache( options.Cache ) );
+
+        // cache needs outputs on disk as soon as file is converted, batch writes its outputs by itself
+        std::unique_ptr<AsyncFileWriter> writer;
+        if( !IsStdio( options.PngFile ) && !cache && !atlasBatch && !options.Info )
+        {
+            writer.reset( new AsyncFileWriter( 2, pool.size() * 4 ) );
+            logVerbose << "writer = " + std::string( writer->backend() );
+        }
+
+        // stdout format depends on request only, not on number of files produced by generators
+        std::unique_ptr<StdoutWriter> stdoutWriter;
+        if( IsStdio( options.PngFile ) && !options.Info )
+        {
+            // per-direction generators write file for each direction, and 'auto' can select one of them
+            const std::vector<std::string> generators   = SplitList( options.Generator );
+            const bool                     perDirection = std::any_of( generators.begin(), generators.end(), []( const std::string& name ) { return name == "auto" || ( Generator.at( name ).Capabilities & PngGeneratorPerDirection ); } );
+
+            const bool tar = options.Tar || options.FrmFile.size() != 1 || IsDirectory( options.FrmFile.front() ) || IsGlobPattern( options.FrmFile.front() ) ||
+                             generators.size() > 1 || perDirection || formats.size() > 1 || metadata != SidecarFormat::None;
+
+            stdoutWriter.reset( new StdoutWriter( tar ) );
+        }
+
+        Conversion conversion;
+        conversion.Output.Format        = formats.front();
+        conversion.Output.AnimDelta     = options.AnimDelta;
+        conversion.Output.Pool          = &pool;
+        conversion.Output.Encoder       = encoder;
+        conversion.Output.Optimize      = options.Optimize;
+        conversion.Output.Metadata      = metadata;
+        conversion.Output.ThumbnailSize = options.Thumbnail;
+        conversion.Output.Sinks         = writer.get();
+        conversion.Formats              = formats;
+        // TODO? make rgbMultiplier configurable
+        conversion.Palette              = std::make_shared<const PaletteTable>( loadPal( options ), 4 /* noon */ );
+        conversion.Batch                = atlasBatch.get();
+        conversion.Incremental          = manifest.get();
+        conversion.Cache                = cache.get();
+        conversion.Stdout               = stdoutWriter.get();
+
+        if( manifest || cache )
+        {
+            conversion.Settings = getSettingsHash( options, *conversion.Palette );
+            logVerbose << "settings hash = " + HashToString( conversion.Settings );
+        }
+
+        logVerbose << "begin frm loop" << 1;
+
+        // files are converted as soon as they're found, while rest of input directories is still being searched
+        // reading files and writing outputs is done by separate threads; memory is limited by depth of queues between them
+
+        InputFiles    inputs( options.FrmFile );
+        InputPrefetch prefetch( inputs, 4, pool.size() );
+        std::size_t   unchanged = 0, cached = 0;
+
+        auto count = [&unchanged, &cached]( ConvertResult result ) {
+            if( result == ConvertResult::Unchanged )
+                unchanged++;
+            else if( result == ConvertResult::Cached )
+                cached++;
+        };
+
+        // batch atlas needs files in order, and all files would write same output when filename is set by user; stdout keeps order by itself
+        convertAll<PrefetchedFile>(
+            pool, logVerbose, !atlasBatch && !options.Info && ( options.PngFile.empty() || stdoutWriter ),
+            [&prefetch]( PrefetchedFile& file ) { return prefetch.next( file ); },
+            [&options, &conversion]( const PrefetchedFile& file, Logging& log, std::ostream& out ) { return convertFile( options, conversion, file, log, out ); },
+            count );
 
-        } // foreach .frm
+        // manifest must not list outputs which failed to be written
+        if( writer )
+            writer->finish();
 
         logVerbose << -1 << "end frm loop";
+
+        if( manifest )
+        {
+            manifest->write();
+            std::cout << "Unchanged files skipped: " << unchanged << std::endl;
+        }
+
+        if( cache )
+            std::cout << "Files restored from cache: " << cached << std::endl;
+
+        if( atlasBatch )
+            atlasBatch->write( options.Batch, logVerbose );
+
+        if( stdoutWriter )
+            stdoutWriter->finish();
     }
     catch( std::exception& e )
     {
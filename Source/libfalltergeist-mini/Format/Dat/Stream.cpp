@@ -42,6 +42,14 @@ namespace Falltergeist
                 setg(cBuf, cBuf, cBuf + size);
             }
 
+            Stream::Stream(const char* data, size_t size)
+            {
+                _buffer.resize(size);
+                auto cBuf = _buffer.data();
+                std::copy(data, data + size, cBuf);
+                setg(cBuf, cBuf, cBuf + size);
+            }
+
             Stream::Stream(Entry& datFileEntry)
             {
                 auto size = datFileEntry.unpackedSize();
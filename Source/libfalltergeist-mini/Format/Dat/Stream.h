@@ -24,6 +24,7 @@ namespace Falltergeist
                 public:
                     Stream(std::ifstream& stream);
                     Stream(Dat::Entry& datFileEntry);
+                    Stream(const char* data, size_t size);
 
                     Stream(Stream&& other);
                     Stream(const Stream&) = delete;
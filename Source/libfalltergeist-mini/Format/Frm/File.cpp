@@ -131,6 +131,11 @@ namespace Falltergeist
                 return height;
             }
 
+            std::vector<Direction>& File::Directions()
+            {
+                return _Directions;
+            }
+
             const std::vector<Direction>& File::Directions() const
             {
                 return _Directions;
@@ -59,6 +59,7 @@ namespace Falltergeist
                 uint16_t MaxFrameWidth() const;
                 uint16_t MaxFrameHeight() const;
 
+                std::vector<Direction>&       Directions();
                 const std::vector<Direction>& Directions() const;
 
                 inline uint8_t DirectionsSize() const